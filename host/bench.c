@@ -0,0 +1,849 @@
+// ------------------------------------------------------------------------ //
+//  Host frame benchmark
+// ------------------------------------------------------------------------ //
+// Renders fixed camera poses on seeded maps and reports time and work per
+// frame.  Frames are deterministic: the checksum column only changes when
+// the rendered pixels change, so it doubles as a regression check when
+// comparing render paths.
+//
+//   ./bench [-n iterations] [-s seed] [-o dump_dir]
+//
+// After the frame table come, in order (README.md says what each must show):
+//   shoot_ray       old per-step-division traversal vs DDA: ns/ray, and how often they agree
+//   spinning        rays per frame casting every column, only span edges, and reusing last frame's
+//   line of sight   query_rays with and without the view's seen squares (must agree 100%)
+//   sprites         culling and drawing sprites, with and without the seen squares
+//   per-stage       the watch's profiler (ENGINE_PROFILE) on each scene
+//   minimap         draw_map every pixel vs from its cache
+//   maze            GenerateMazeMap time per size, and that a seed repeats
+//   flow field      keeping the agents' field up to date, and moving them
+//   frame pacing    the scheduler on a fake clock, frames drawn and dropped, idling
+//   tilt input      the accelerometer filter against peeking every tick
+//   quality         the adaptive render quality settling on a slow watch
+//   streamed world  chunk cache hits and stalls walking the world, with and without prefetch
+// src/main.c (layers, timers, buttons, battery) isn't built here, only the engine.
+#include "../src/main.h"
+#include <getopt.h>
+#include <math.h>
+
+#define POSE_CELLS 4                   // Start cells per map
+#define POSE_FACINGS 8                 // Facings per start cell
+#define MAX_POSES (POSE_CELLS * POSE_FACINGS)
+
+typedef struct SceneStruct {
+  const char *name;
+  void (*generate)(void);
+} SceneStruct;
+
+typedef struct ConfigStruct {
+  const char *name;
+  void (*apply)(void);
+  bool dirty;                          // Fill the view white before each frame (output must not change)
+} ConfigStruct;
+
+static uint32_t seed = 1;
+static int32_t iterations = 50;
+static const char *dump_dir = NULL;
+
+// ------------------------------------------------------------------------ //
+//  Scenes
+// ------------------------------------------------------------------------ //
+static void scene_random(void) {create_map(mapsize, mapsize); srand(seed); GenerateRandomMap();}
+static void scene_maze(void)   {create_map(mapsize, mapsize); GenerateMazeMap(map_w/2, 0, seed);}
+static void scene_open(void)   {create_map(mapsize, mapsize); for(int32_t i=0; i<map_w; i++) {setcell(i, 0, 1); setcell(i, map_h-1, 1); setcell(0, i, 1); setcell(map_w-1, i, 1);}}
+static void scene_mirrors(void) {create_map(mapsize, mapsize); for(int32_t i=0; i<map_w; i++) {setcell(i, 0, 4); setcell(i, map_h-1, 4); setcell(0, i, 4); setcell(map_w-1, i, 4);}}
+static void scene_empty(void)  {create_map(mapsize, mapsize);}
+static void scene_large(void)  {create_map(MAP_MAX, MAP_MAX); srand(seed); GenerateRandomMap();}
+static void scene_world(void)  {if(!open_world(RESOURCE_ID_WORLD)) {fprintf(stderr, "could not open %s/data/world.bin\n", RESOURCE_DIR); exit(1);}}
+
+static const SceneStruct scenes[] = {
+  {"random", scene_random},
+  {"maze",   scene_maze},
+  {"open",   scene_open},   // Only a border wall: every ray crosses most of the map
+  {"empty",  scene_empty},  // No walls at all: every ray runs off the map
+  {"mirrors", scene_mirrors}, // Mirror border wall: rays bounce until they run out of range
+  {"large",  scene_large},  // MAP_MAX x MAP_MAX random map
+  {"world",  scene_world},  // Streamed world (resources/data/world.bin) through the chunk cache
+};
+
+// ------------------------------------------------------------------------ //
+//  Render configurations
+// ------------------------------------------------------------------------ //
+static OptionsStruct defaults;  // options as the watch build sets them
+
+static void config_default(void) {}
+static void config_legacy(void)  {options.dda = false;}
+static void config_floor_cols(void) {options.floor_rows = false;}
+static void config_unbatched(void) {options.batched = false;}
+static void config_exhaustive(void) {options.coherent = false; options.reuse = false;}
+static void config_night(void) {options.range = NIGHT_RANGE; options.fog = NIGHT_FOG;}
+static void config_q2(void) {options.quality = 2;}
+static void config_q1(void) {options.quality = 1;}
+static void config_q0(void) {options.quality = 0;}
+static void config_q1_cols(void) {options.quality = 1; options.floor_rows = false; options.batched = false;}
+static void config_shaded(void) {options.render = RENDER_SHADED;}
+static void config_shaded_unbatched(void) {options.render = RENDER_SHADED; options.batched = false;}
+static void config_wireframe(void) {options.render = RENDER_WIREFRAME;}
+
+static const ConfigStruct configs[] = {
+  {"default", config_default},
+  {"exhaustive", config_exhaustive}, // A ray for every column (same checksum as default)
+  {"legacy",  config_legacy},   // Per-step division ray traversal
+  {"floorcols", config_floor_cols},  // Floor/ceiling cast down each column
+  {"unbatched", config_unbatched},   // Columns ORed straight into the framebuffer
+  {"night",   config_night},    // Can only see 3 squares: short rays, fog
+  {"dirty",   config_default, true}, // Same checksum as default: frames don't depend on what was on screen
+  {"q2",      config_q2},       // Lower render quality (what main.c drops to when frames run over budget)
+  {"q1",      config_q1},
+  {"q0",      config_q0},
+  {"q1dirty", config_q1, true}, // Same checksum as q1
+  {"q1cols",  config_q1_cols},  // q1 with floor down each column, straight into the framebuffer
+  {"shaded",  config_shaded},   // Flat dithered walls, no floor: the other render paths
+  {"shadedub", config_shaded_unbatched}, // Same checksum as shaded
+  {"wireframe", config_wireframe},
+  {"wiredirty", config_wireframe, true}, // Same checksum as wireframe
+};
+
+// ------------------------------------------------------------------------ //
+//  Poses
+// ------------------------------------------------------------------------ //
+// Nearest open cell to each quarter point of the map, looking 8 ways.
+static int32_t make_poses(PlayerStruct *poses) {
+  static const int32_t quarter[POSE_CELLS][2] = {{1, 1}, {3, 1}, {1, 3}, {3, 3}};
+  int32_t count = 0;
+  for(int32_t q=0; q<POSE_CELLS; q++) {
+    int32_t cx = quarter[q][0] * map_w / 4, cy = quarter[q][1] * map_h / 4;
+    for(int32_t r=0; r<map_w; r++) {
+      bool found = false;
+      for(int32_t y=cy-r; y<=cy+r && !found; y++)
+        for(int32_t x=cx-r; x<=cx+r && !found; x++)
+          if(x>=0 && y>=0 && x<map_w && y<map_h && getcell(x, y)<=0) {
+            for(int32_t f=0; f<POSE_FACINGS; f++)
+              poses[count++] = (PlayerStruct){.x=x*64+32, .y=y*64+32, .facing=f*(TRIG_MAX_ANGLE/POSE_FACINGS) + 1000};
+            found = true;
+          }
+      if(found) break;
+    }
+  }
+  return count;
+}
+
+// ------------------------------------------------------------------------ //
+//  Helpers
+// ------------------------------------------------------------------------ //
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, uint32_t len) {
+  for(uint32_t i=0; i<len; i++) hash = (hash ^ data[i]) * 16777619u;
+  return hash;
+}
+
+static void dump_pbm(GContext *ctx, const char *scene, const char *config, int32_t pose) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s-%s-%02d.pbm", dump_dir, scene, config, (int)pose);
+  FILE *f = fopen(path, "wb");
+  if(!f) {perror(path); return;}
+  GBitmap *fb = &ctx->dest_bitmap;
+  fprintf(f, "P1\n%d %d\n", fb->bounds.size.w, fb->bounds.size.h);
+  for(int32_t y=0; y<fb->bounds.size.h; y++) {
+    for(int32_t x=0; x<fb->bounds.size.w; x++)
+      fputc(((((uint8_t*)fb->addr)[y*fb->row_size_bytes + (x>>3)] >> (x&7)) & 1) ? '0' : '1', f);  // PBM: 1 = black
+    fputc('\n', f);
+  }
+  fclose(f);
+}
+
+// ------------------------------------------------------------------------ //
+//  Benchmark
+// ------------------------------------------------------------------------ //
+static void run(GContext *ctx, const SceneStruct *scene, const ConfigStruct *config) {
+  PlayerStruct poses[MAX_POSES];
+  uint32_t checksum = 2166136261u;
+  uint64_t total_ns = 0;
+
+  scene->generate();
+  options = defaults;
+  config->apply();
+  int32_t pose_count = make_poses(poses);
+
+  // One untimed pass collects the counters and the checksum
+  memset(&stats, 0, sizeof(stats));
+  for(int32_t p=0; p<pose_count; p++) {
+    player = poses[p];
+    host_context_clear(ctx);
+    if(config->dirty) graphics_fill_rect(ctx, view, 0, GCornerNone);
+    draw_frame(ctx, view);  // The watch's HUD draws it once; in the checksum so frames look the same as before
+    draw_3D(ctx, view);
+    checksum = fnv1a(checksum, ctx->dest_bitmap.addr, ctx->dest_bitmap.row_size_bytes * ctx->dest_bitmap.bounds.size.h);
+    if(dump_dir) dump_pbm(ctx, scene->name, config->name, p);
+  }
+  StatsStruct counted = stats;
+
+  for(int32_t i=0; i<iterations; i++)
+    for(int32_t p=0; p<pose_count; p++) {
+      player = poses[p];
+      host_context_clear(ctx);
+      if(config->dirty) graphics_fill_rect(ctx, view, 0, GCornerNone);
+      uint64_t start = now_ns();
+      draw_3D(ctx, view);
+      total_ns += now_ns() - start;
+    }
+
+  double frames = (double)pose_count * iterations;
+  printf("%-8s %-12s %6d %10.0f %8.1f %7.1f %8.1f %9.1f %9.1f  %08x\n",
+         scene->name, config->name, (int)pose_count,
+         total_ns / frames, total_ns / frames / view.size.w,
+         counted.rays / (double)pose_count, counted.ray_steps / (double)pose_count,
+         counted.wall_pixels / (double)pose_count, counted.floor_pixels / (double)pose_count,
+         checksum);
+}
+
+// ------------------------------------------------------------------------ //
+//  Ray traversal: old vs DDA
+// ------------------------------------------------------------------------ //
+#define LONG_RAY (64 * 8)             // Rays longer than 8 squares count as long-range
+#define MAX_RAYS (MAX_POSES * 144)
+
+typedef struct RaySampleStruct {
+  int32_t x, y, angle;
+} RaySampleStruct;
+
+static uint64_t time_rays(const RaySampleStruct *samples, int32_t count, bool dda) {
+  options.dda = dda;
+  uint64_t start = now_ns();
+  for(int32_t i=0; i<iterations; i++)
+    for(int32_t r=0; r<count; r++)
+      shoot_ray(samples[r].x, samples[r].y, samples[r].angle);
+  return now_ns() - start;
+}
+
+static void run_rays(const SceneStruct *scene) {
+  static RaySampleStruct all[MAX_RAYS], far[MAX_RAYS];
+  PlayerStruct poses[MAX_POSES];
+  int32_t all_count = 0, far_count = 0, same_face = 0, same_dist = 0, same_offset = 0, max_offset = 0;
+
+  scene->generate();
+  options = defaults;
+  int32_t pose_count = make_poses(poses);
+  for(int32_t p=0; p<pose_count; p++)
+    for(int16_t col=0; col<view.size.w; col++) {
+      RaySampleStruct sample = {poses[p].x, poses[p].y, poses[p].facing + (fov * (col - (view.size.w>>1))) / view.size.w};
+      options.dda = false; int32_t old_result = shoot_ray(sample.x, sample.y, sample.angle); RayStruct old = ray;
+      options.dda = true;  int32_t new_result = shoot_ray(sample.x, sample.y, sample.angle);
+      all[all_count++] = sample;
+      if(old_result == 1 && old.dist > LONG_RAY) far[far_count++] = sample;
+      if(old_result != new_result) continue;
+      if(old_result != 1 || (old.hit == ray.hit && old.face == ray.face && (old.x>>6) == (ray.x>>6) && (old.y>>6) == (ray.y>>6))) {
+        same_face++;
+        if(old_result != 1 || old.dist == ray.dist) same_dist++;
+        if(old_result != 1 || old.offset == ray.offset) same_offset++;
+        else if(abs32(old.offset - ray.offset) > max_offset) max_offset = abs32(old.offset - ray.offset);
+      }
+    }
+
+  double old_all = time_rays(all, all_count, false) / ((double)all_count * iterations);
+  double new_all = time_rays(all, all_count, true)  / ((double)all_count * iterations);
+  double old_far = far_count ? time_rays(far, far_count, false) / ((double)far_count * iterations) : 0;
+  double new_far = far_count ? time_rays(far, far_count, true)  / ((double)far_count * iterations) : 0;
+  printf("%-8s %6d %8.1f %8.1f %6.0f%% %6d %8.1f %8.1f %6.0f%%   %5.1f%% %5.1f%% %5.1f%% %4d\n",
+         scene->name, (int)all_count, old_all, new_all, 100.0 * (1.0 - new_all / old_all),
+         (int)far_count, old_far, new_far, far_count ? 100.0 * (1.0 - new_far / old_far) : 0.0,
+         100.0 * same_face / all_count, 100.0 * same_dist / all_count, 100.0 * same_offset / all_count, (int)max_offset);
+  options = defaults;
+}
+
+// ------------------------------------------------------------------------ //
+//  Spinning in place
+// ------------------------------------------------------------------------ //
+// Turning without moving, the way most of the game gets played: every frame but the first at each spot
+// can reuse last frame's rays.  The checksum must be the same with and without reuse.
+#define SPIN_FRAMES 64
+#define SPIN_STEP 800                  // accel.x of 100 (main_loop turns by accel.x<<3)
+
+static void run_spin(GContext *ctx, const SceneStruct *scene, const char *name, bool coherent, bool reuse) {
+  PlayerStruct poses[MAX_POSES];
+  uint32_t checksum = 2166136261u;
+  uint64_t total_ns = 0;
+
+  scene->generate();
+  options = defaults;
+  options.coherent = coherent;
+  options.reuse = reuse;
+  int32_t pose_count = make_poses(poses);
+  memset(&stats, 0, sizeof(stats));
+  for(int32_t p=0; p<pose_count; p+=POSE_FACINGS) {
+    player = poses[p];
+    for(int32_t f=0; f<SPIN_FRAMES; f++, player.facing += SPIN_STEP) {
+      host_context_clear(ctx);
+      uint64_t start = now_ns();
+      draw_3D(ctx, view);
+      total_ns += now_ns() - start;
+      checksum = fnv1a(checksum, ctx->dest_bitmap.addr, ctx->dest_bitmap.row_size_bytes * ctx->dest_bitmap.bounds.size.h);
+    }
+  }
+  double frames = (double)(pose_count / POSE_FACINGS) * SPIN_FRAMES;
+  printf("%-8s %-10s %10.0f %7.1f %8.1f  %08x\n", scene->name, name, total_ns / frames, stats.rays / frames, stats.ray_steps / frames, checksum);
+  options = defaults;
+}
+
+// ------------------------------------------------------------------------ //
+//  Line of sight
+// ------------------------------------------------------------------------ //
+// After each frame, SIGHT_QUERIES points on open squares ask query_rays whether they can see the player, with and
+// without the squares the frame's rays marked.  Queries always walk, so the marks must change nothing: counts how
+// many were clear, and how many answers agree (anything but 100% is a bug).
+#define SIGHT_QUERIES 128
+
+static void run_sight(GContext *ctx, const SceneStruct *scene) {
+  PlayerStruct poses[MAX_POSES];
+  RayQueryStruct queries[2][SIGHT_QUERIES];
+  uint64_t ns[2] = {0, 0};
+  uint32_t clear = 0, agree = 0, random = seed;
+  scene->generate();
+  options = defaults;
+  int32_t pose_count = make_poses(poses);
+  for(int32_t p=0; p<pose_count; p++) {
+    player = poses[p];
+    for(int32_t q=0; q<SIGHT_QUERIES; ) {  // Open squares within 16 of the player
+      random = random * 1103515245 + 12345;
+      int32_t x = (player.x >> 6) + (int32_t)((random >> 8) % 33) - 16, y = (player.y >> 6) + (int32_t)((random >> 20) % 33) - 16;
+      if(getcell_far(x, y) > 0) continue;
+      queries[0][q] = queries[1][q] = (RayQueryStruct){.kind = RAY_SIGHT, .x = 64*x + 32, .y = 64*y + 32, .tox = player.x, .toy = player.y};
+      q++;
+    }
+    for(int32_t marks=0; marks<2; marks++) {
+      options.seen_cells = marks;
+      host_context_clear(ctx);
+      draw_3D(ctx, view);
+      uint64_t start = now_ns();
+      for(int32_t i=0; i<iterations; i++) query_rays(queries[marks], SIGHT_QUERIES);
+      ns[marks] += now_ns() - start;
+    }
+    for(int32_t q=0; q<SIGHT_QUERIES; q++) {clear += queries[0][q].result; agree += queries[0][q].result == queries[1][q].result;}
+  }
+  double queries_run = (double)pose_count * SIGHT_QUERIES;
+  printf("%-8s %8.0f %8.0f %7.1f%% %7.2f%%%s\n", scene->name, ns[0] / (queries_run * iterations), ns[1] / (queries_run * iterations),
+         100.0 * clear / queries_run, 100.0 * agree / queries_run, agree == pose_count * SIGHT_QUERIES ? "" : "  DIFFERENT");
+  options = defaults;
+}
+
+// ------------------------------------------------------------------------ //
+//  Sprites
+// ------------------------------------------------------------------------ //
+// count sprites on random open squares, drawn from every pose: ns per frame, ns of it in the sprite stage (the
+// profiler's PROFILE_SPRITES), and how many were left to draw after culling.  Then the same frames without the view's
+// seen squares, so every sprite is checked against the walls column by column: the checksums must match.
+#define SPRITE_RUNS 3
+
+static uint32_t sprite_frames(GContext *ctx, const PlayerStruct *poses, int32_t pose_count, double *frame_ns, double *sprite_ns) {
+  uint32_t checksum = 2166136261u;
+  uint64_t best = UINT64_MAX;
+  for(int32_t p=0; p<pose_count; p++) {
+    player = poses[p];
+    host_context_clear(ctx);
+    draw_3D(ctx, view);
+    checksum = fnv1a(checksum, ctx->dest_bitmap.addr, ctx->dest_bitmap.row_size_bytes * ctx->dest_bitmap.bounds.size.h);
+  }
+  profile_reset();
+  for(int32_t run=0; run<SPRITE_RUNS; run++) {  // Best of SPRITE_RUNS for the whole frame
+    uint64_t start = now_ns();
+    for(int32_t i=0; i<iterations; i++)
+      for(int32_t p=0; p<pose_count; p++) {player = poses[p]; draw_3D(ctx, view);}
+    if(now_ns() - start < best) best = now_ns() - start;
+  }
+  double frames = (double)pose_count * iterations;
+  *frame_ns = best / frames;
+  *sprite_ns = profile_now[PROFILE_SPRITES] * 1000.0 / (frames * SPRITE_RUNS);
+  return checksum;
+}
+
+static void run_sprites(GContext *ctx, const SceneStruct *scene, int32_t count) {
+  PlayerStruct poses[MAX_POSES];
+  double frame_ns, sprite_ns, unmarked_frame_ns, unmarked_ns;
+  uint32_t random = seed ^ 0x5B1E;
+  scene->generate();
+  options = defaults;
+  int32_t pose_count = make_poses(poses);
+  for(sprite_count=0; sprite_count<count; ) {
+    random = random * 1103515245 + 12345;
+    int32_t x = (random >> 8) % map_w, y = (random >> 20) % map_h;
+    if(getcell(x, y) <= 0) sprites[sprite_count++] = (SpriteStruct){.x = 64*x + 16 + (random & 31), .y = 64*y + 16 + ((random >> 5) & 31), .image = SPRITE_AGENT};
+  }
+  memset(&stats, 0, sizeof(stats));
+  uint32_t checksum = sprite_frames(ctx, poses, pose_count, &frame_ns, &sprite_ns);
+  double drawn = stats.sprites_drawn / (double)(pose_count * (SPRITE_RUNS * iterations + 1));
+  options.seen_cells = false;
+  uint32_t unmarked = sprite_frames(ctx, poses, pose_count, &unmarked_frame_ns, &unmarked_ns);
+  printf("%-8s %7d %10.0f %10.0f %8.1f %10.0f  %08x %s\n", scene->name, (int)count, frame_ns, sprite_ns, drawn, unmarked_ns,
+         checksum, unmarked == checksum ? "same" : "DIFFERENT");
+  sprite_count = 0;
+  options = defaults;
+}
+
+// ------------------------------------------------------------------------ //
+//  Per-stage profile
+// ------------------------------------------------------------------------ //
+// The watch's profiler (ENGINE_PROFILE) over the last PROFILE_FRAMES frames of each scene: the same
+// min/avg/p95 the on-screen overlay shows, here with a us clock.
+static void run_profile(GContext *ctx, const SceneStruct *scene) {
+  PlayerStruct poses[MAX_POSES];
+  scene->generate();
+  options = defaults;
+  int32_t pose_count = make_poses(poses);
+  profile_reset();
+  for(int32_t i=0; i<iterations; i++)
+    for(int32_t p=0; p<pose_count; p++) {
+      player = poses[p];
+      host_context_clear(ctx);
+      {PROFILE_SCOPE(PROFILE_FRAME); draw_3D(ctx, view); draw_map(ctx, GRect(4, 110, 40, 40), 4);}
+      profile_end_frame();
+    }
+  printf("%-8s", scene->name);
+  for(int32_t v=0; v<PROFILE_VALUES; v++) {
+    if(v == PROFILE_TEXT) continue;  // No text box on the host
+    ProfileSummaryStruct sum = profile_summary(v);
+    printf(" %5u %5u %5u", sum.min, sum.avg, sum.p95);
+  }
+  printf("\n");
+}
+
+// ------------------------------------------------------------------------ //
+//  Minimap
+// ------------------------------------------------------------------------ //
+// draw_map on its own, every pixel every frame against the cached image, with the player standing still,
+// walking (the box scrolls, now and then off the cache), or changing a square near them every frame.
+// The checksums must match (the flashing cursor is painted over first).  "clipped" hangs the box off the
+// bottom left of the screen, which only the cached path can do.
+#define MAP_FRAMES 512
+#define MAP_BOX GRect(4, 110, 40, 40)
+
+static void run_map(GContext *ctx, const SceneStruct *scene, const char *motion, GRect box) {
+  uint64_t ns[2];
+  uint32_t checksum[2];
+  for(int32_t cached=0; cached<2; cached++) {
+    PlayerStruct poses[MAX_POSES];
+    uint32_t random = seed;
+    scene->generate();
+    options = defaults;
+    options.cached_map = cached;
+    make_poses(poses);
+    player = poses[0];
+    ns[cached] = 0; checksum[cached] = 2166136261u;
+    if(!cached && (box.origin.x < 0 || box.origin.y + box.size.h > 168)) {ns[0] = 0; checksum[0] = 0; continue;}
+    for(int32_t f=0; f<MAP_FRAMES; f++) {
+      if(motion[0] == 'w') {
+        int32_t x = player.x, y = player.y;
+        walk(player.facing, 24);
+        if(player.x == x && player.y == y) player.facing += TRIG_MAX_ANGLE / 4 + 1000;  // Stuck: turn away
+      } else if(motion[0] == 'e' && !map_streamed) {
+        random = random * 1103515245 + 12345;
+        int32_t x = (player.x >> 6) + (int32_t)((random >> 16) % 9) - 4, y = (player.y >> 6) + (int32_t)((random >> 24) % 9) - 4;
+        if(x >= 0 && y >= 0 && x < map_w && y < map_h && (x != player.x >> 6 || y != player.y >> 6)) setcell(x, y, getcell(x, y) > 0 ? 0 : 1);
+      }
+      host_context_clear(ctx);
+      uint64_t start = now_ns();
+      draw_map(ctx, box, 4);
+      ns[cached] += now_ns() - start;
+      graphics_context_set_fill_color(ctx, 0);
+      graphics_fill_rect(ctx, GRect((box.size.w/2)+box.origin.x - 1, (box.size.h/2)+box.origin.y - 1, 3, 3), 0, GCornerNone);  // Cursor
+      checksum[cached] = fnv1a(checksum[cached], ctx->dest_bitmap.addr, ctx->dest_bitmap.row_size_bytes * ctx->dest_bitmap.bounds.size.h);
+    }
+  }
+  printf("%-8s %-8s %9.0f %9.0f %6.1fx  %08x %08x\n", scene->name, motion, ns[0] / (double)MAP_FRAMES, ns[1] / (double)MAP_FRAMES,
+         ns[1] ? (double)ns[0] / ns[1] : 0.0, checksum[0], checksum[1]);
+  options = defaults;
+}
+
+// ------------------------------------------------------------------------ //
+//  Maze generation
+// ------------------------------------------------------------------------ //
+// GenerateMazeMap at each map size up to MAP_MAX: time per maze and per square (flat if it's linear), how much
+// got dug, and a checksum of the map.  Generating again from the same seed must give the same checksum.
+static uint32_t map_checksum(void) {
+  uint32_t checksum = 2166136261u;
+  for(int32_t y=0; y<map_h; y++)
+    for(int32_t x=0; x<map_w; x++) {uint8_t cell = getcell(x, y); checksum = fnv1a(checksum, &cell, 1);}
+  return checksum;
+}
+
+static void run_maze(int32_t size) {
+  create_map(size, size);
+  GenerateMazeMap(map_w/2, 0, seed);
+  uint32_t checksum = map_checksum(), open = 0, dead_ends = 0;
+  for(int32_t y=0; y<map_h; y++)
+    for(int32_t x=0; x<map_w; x++) {open += getcell(x, y) <= 0; dead_ends += getcell(x, y) < 0;}
+
+  uint64_t start = now_ns();
+  for(int32_t i=0; i<iterations; i++) GenerateMazeMap(map_w/2, 0, seed);
+  double ns = (now_ns() - start) / (double)iterations;
+  uint32_t again = map_checksum();
+  printf("%4dx%-4d %10.0f %8.1f %6.1f%% %6u  %08x %s\n", (int)size, (int)size, ns, ns / (size * size),
+         100.0 * open / (size * size), dead_ends, checksum, again == checksum ? "same" : "DIFFERENT");
+}
+
+// ------------------------------------------------------------------------ //
+//  Flow field
+// ------------------------------------------------------------------------ //
+// The player walks FLOW_TICKS simulation ticks around a random map or a maze, toggling a square nearby every
+// FLOW_EDIT ticks, with agents chasing.  Times flow_update and move_agents per tick.  flow_update only works the
+// field out when the player's square or the map changed, so it also counts those ticks, and the time and squares
+// visited per field worked out.  At the end the field must match one worked out from scratch (check), and `caught`
+// is how many agents got to the player's square.
+#define FLOW_TICKS 2000
+#define FLOW_EDIT 16
+
+static uint64_t ns_agents;  // Time in move_agents
+static uint32_t flow_builds;  // Ticks where the player's square or the map changed
+
+static uint32_t flow_checksum(void) {
+  uint32_t checksum = 2166136261u;
+  for(int32_t y=0; y<map_h; y++)
+    for(int32_t x=0; x<map_w; x++) {uint16_t d = flow_dist(x, y); checksum = fnv1a(checksum, (const uint8_t*)&d, sizeof(d));}
+  return checksum;
+}
+
+// Walks the same path every time for a kind and size.  Returns ns spent in flow_update
+static uint64_t flow_walk(const char *kind, int32_t size) {
+  uint32_t random = seed;
+  create_map(size, size);
+  if(kind[0] == 'm') {
+    GenerateMazeMap(map_w/2, 0, seed);
+    player = (PlayerStruct){.x = 64*(map_w/2) + 32, .y = 32, .facing = TRIG_MAX_ANGLE / 4};  // Maze starts here, facing in
+  } else {
+    srand(seed); GenerateRandomMap();
+    setcell(map_w/2, map_h/2, 0);
+    player = (PlayerStruct){.x = 64*(map_w/2) + 32, .y = 64*(map_h/2) + 32, .facing = 0};
+  }
+  flow_reset();
+  flow_update(player.x >> 6, player.y >> 6);
+
+  uint64_t ns = 0;
+  for(int32_t t=0; t<FLOW_TICKS; t++) {
+    int32_t x = player.x, y = player.y;
+    uint32_t changes = map_changes;
+    walk(player.facing, 24);
+    if(player.x == x && player.y == y) player.facing += TRIG_MAX_ANGLE / 4 + 1000;  // Stuck: turn away
+    if(t % FLOW_EDIT == 0) {
+      random = random * 1103515245 + 12345;
+      int32_t ex = (player.x >> 6) + (int32_t)((random >> 16) % 9) - 4, ey = (player.y >> 6) + (int32_t)((random >> 24) % 9) - 4;
+      if(ex >= 0 && ey >= 0 && ex < map_w && ey < map_h && (ex != player.x >> 6 || ey != player.y >> 6)) setcell(ex, ey, getcell(ex, ey) > 0 ? 0 : 1);
+    }
+    flow_builds += changes != map_changes || x >> 6 != player.x >> 6 || y >> 6 != player.y >> 6;
+    uint64_t start = now_ns();
+    flow_update(player.x >> 6, player.y >> 6);
+    ns += now_ns() - start;
+    start = now_ns(); move_agents(); ns_agents += now_ns() - start;
+  }
+  return ns;
+}
+
+static void run_flow(const char *kind, int32_t size, int32_t count) {
+  uint32_t random = seed ^ 0x5EED;
+  create_map(size, size);  // Agents go on open squares of the map they'll walk (flow_walk makes it again)
+  if(kind[0] == 'm') GenerateMazeMap(map_w/2, 0, seed); else {srand(seed); GenerateRandomMap();}
+  clear_agents();
+  for(int32_t tries=0; agent_count < count && tries < 100000; tries++) {
+    random = random * 1103515245 + 12345;
+    int32_t x = (random >> 8) % map_w, y = (random >> 20) % map_h;
+    if(!solid(x, y)) add_agent(64*x + 32, 64*y + 32);
+  }
+
+  ns_agents = 0; flow_builds = 0;
+  memset(&stats, 0, sizeof(stats));
+  uint64_t ns = flow_walk(kind, size);
+  uint32_t kept = flow_checksum(), squares = stats.flow_squares, caught = 0, builds = flow_builds ? flow_builds : 1;
+  for(int32_t a=0; a<agent_count; a++) caught += flow_dist(agents[a].x >> 6, agents[a].y >> 6) == 0;
+  flow_reset();
+  flow_update(player.x >> 6, player.y >> 6);
+
+  printf("%-6s %4dx%-4d %6d %10.0f %10.0f %7.1f%% %10.0f %9.1f %6u  %s\n", kind, (int)size, (int)size, (int)count,
+         ns / (double)FLOW_TICKS, ns_agents / (double)FLOW_TICKS, flow_builds * 100.0 / FLOW_TICKS, ns / (double)builds,
+         squares / (double)builds, caught, flow_checksum() == kept ? "same" : "DIFFERENT");
+  clear_agents();
+}
+
+// ------------------------------------------------------------------------ //
+//  Frame pacing
+// ------------------------------------------------------------------------ //
+// Runs the scheduler the way main_loop does, on a fake clock, for frames that take a fixed time to draw
+// (0ms too: it used to divide by the frame time).  With sleep_ms, the loop idles that long after every frame and
+// comes back through scheduler_resume, the way main_loop backs off while the watch lies still: that must drop
+// no frames and lose no time.  Simulation time must always add up: ticks * SIM_TICK_MS plus time let go after
+// stalls plus time slept through plus time still due = time passed.
+#define PACE_MS 10000
+
+static void run_pacing(uint32_t draw_ms, uint32_t sleep_ms) {
+  SchedulerStruct s;
+  uint32_t now = 12345;                // Anywhere on the clock
+  scheduler_start(&s, now);
+  while(now - 12345 < PACE_MS) {
+    if(sleep_ms) scheduler_resume(&s, now);
+    if(scheduler_update(&s, now) > 0) {scheduler_frame(&s, now, now + draw_ms); now += draw_ms;}
+    now += sleep_ms ? sleep_ms : scheduler_wait(&s, now);
+  }
+  uint32_t passed = now - 12345;
+  int32_t error = (int32_t)(passed - s.ticks * SIM_TICK_MS - s.lost_ms - s.slept_ms - (s.behind + (now - s.last)));
+  printf("%7u %6u %6u %7u %7u %7u %5u %7.1f %7u %6d\n", draw_ms, sleep_ms, s.ticks, s.frames, s.frames_dropped, s.frames_over, s.fps,
+         s.frame_avg / 16.0, s.lost_ms, (int)error);
+}
+
+// ------------------------------------------------------------------------ //
+//  Tilt input
+// ------------------------------------------------------------------------ //
+// Made-up accelerometer samples at ACCEL_RATE_HZ with +-noise milli-g on each axis, read by main_loop every
+// SIM_TICK_MS: the old way (accel_service_peek, the latest raw sample) against input.c's batches.  Lying flat:
+// how many ticks see the watch as moving (no idle back-off).  Held at TILT_HELD: how much what the tick sees
+// jitters.  Tilted from flat to TILT_HELD at TILT_STEPS random moments: how long until a tick sees half of it.
+#define TILT_HELD 300
+#define TILT_STEPS 200
+#define TILT_MS 2000                   // Each step is watched for this long
+#define TILT_SETTLE_MS 500             // Lying flat and held: ticks before this aren't counted (the filter settling)
+
+typedef struct TiltRunStruct {
+  uint32_t ticks, moving;              // Ticks, and ticks not still
+  double sum, sum2;                    // What the ticks saw (x), for the jitter
+  uint32_t latency_ms;                 // Step to half of it
+} TiltRunStruct;
+
+static uint32_t tilt_random;
+static int16_t tilt_noise(int32_t noise) {
+  tilt_random = tilt_random * 1103515245 + 12345;
+  return noise ? (int32_t)((tilt_random >> 8) % (2 * noise + 1)) - noise : 0;
+}
+
+// Tilt x goes from 0 to to at step_ms (or is to from the start, step_ms = 0).  Ticks start at tick_ms
+static void tilt_run(TiltRunStruct *r, bool batched, int32_t noise, int32_t to, uint32_t step_ms, uint32_t tick_ms) {
+  static const int32_t half = (TILT_HELD - ACCEL_DEAD_ZONE) / 2;
+  TiltStruct tilt;
+  AccelData batch[ACCEL_BATCH], latest = {0};
+  uint32_t count = 0, sample_ms = 1000 / ACCEL_RATE_HZ;
+  tilt_reset(&tilt);
+  *r = (TiltRunStruct){.latency_ms = TILT_MS};
+  for(uint32_t ms=0, next_sample=0, next_tick=tick_ms; ms<TILT_MS; ms++) {
+    if(ms == next_sample) {
+      latest = (AccelData){.x = (ms >= step_ms ? to : 0) + tilt_noise(noise), .y = tilt_noise(noise), .z = -1000};
+      batch[count++] = latest;
+      if(count == ACCEL_BATCH) {tilt_filter(&tilt, batch, count); count = 0;}
+      next_sample += sample_ms;
+    }
+    if(ms == next_tick) {
+      int32_t x, y;
+      if(batched) tilt_read(&tilt, &x, &y);
+      else {x = abs32(latest.x) < ACCEL_DEAD_ZONE && abs32(latest.y) < ACCEL_DEAD_ZONE ? 0 : latest.x; y = latest.y;}  // The old main_loop
+      bool still = batched ? x == 0 && y == 0 : x == 0;
+      if(ms >= TILT_SETTLE_MS) {r->ticks++; r->moving += !still; r->sum += x; r->sum2 += (double)x * x;}
+      if(to && ms >= step_ms && r->latency_ms == TILT_MS && x >= (batched ? half : TILT_HELD / 2)) r->latency_ms = ms - step_ms;
+      next_tick += SIM_TICK_MS;
+    }
+  }
+}
+
+static void run_tilt(int32_t noise) {
+  TiltRunStruct r;
+  double still[2], jitter[2], latency[2];
+  for(int32_t batched=0; batched<2; batched++) {
+    tilt_random = seed;
+    tilt_run(&r, batched, noise, 0, 0, 7);
+    still[batched] = 100.0 * r.moving / r.ticks;
+    tilt_run(&r, batched, noise, TILT_HELD, 0, 7);
+    double mean = r.sum / r.ticks;
+    jitter[batched] = sqrt(r.sum2 / r.ticks - mean * mean);
+    uint32_t total = 0;
+    for(int32_t i=0; i<TILT_STEPS; i++) {
+      uint32_t step = 500 + (tilt_random >> 8) % 500, tick = (tilt_random >> 20) % SIM_TICK_MS;  // Anywhere between samples and ticks
+      tilt_run(&r, batched, noise, TILT_HELD, step, tick);
+      total += r.latency_ms;
+    }
+    latency[batched] = (double)total / TILT_STEPS;
+  }
+  printf("%6d %6d %7.1f %8.1f%% %7.1f%% %7.1f %7.1f %7.0f %7.0f  %s\n", (int)noise, 1000 / SIM_TICK_MS, (double)ACCEL_RATE_HZ / ACCEL_BATCH,
+         still[0], still[1], jitter[0], jitter[1], latency[0], latency[1], latency[1] <= ACCEL_LATENCY_MS ? "ok" : "OVER");
+}
+
+// ------------------------------------------------------------------------ //
+//  Adaptive quality
+// ------------------------------------------------------------------------ //
+// The same fake clock, but each frame takes as long as the host took to draw it at the quality the scheduler
+// picked, scaled so a full quality frame on the "random" scene takes full_ms: how a watch that much slower
+// than FRAME_BUDGET_MS would settle.  Shows the frames drawn at each level.
+static void run_adaptive(GContext *ctx, uint32_t full_ms) {
+  static double level_ns[QUALITY_LEVELS];
+  PlayerStruct poses[MAX_POSES];
+  scene_random();
+  int32_t pose_count = make_poses(poses);
+  if(level_ns[0] == 0)
+    for(int32_t q=0; q<QUALITY_LEVELS; q++) {
+      options = defaults;
+      options.quality = q;
+      uint64_t start = now_ns();
+      for(int32_t i=0; i<iterations; i++)
+        for(int32_t p=0; p<pose_count; p++) {player = poses[p]; host_context_clear(ctx); draw_3D(ctx, view);}
+      level_ns[q] = (now_ns() - start) / ((double)pose_count * iterations);
+    }
+  options = defaults;
+
+  SchedulerStruct s;
+  uint32_t now = 12345, at_level[QUALITY_LEVELS] = {0};
+  scheduler_start(&s, now);
+  while(now - 12345 < PACE_MS) {
+    if(scheduler_update(&s, now) > 0) {
+      uint32_t draw_ms = full_ms * level_ns[s.quality] / level_ns[QUALITY_FULL] + 0.5;
+      at_level[s.quality]++;
+      scheduler_frame(&s, now, now + draw_ms);
+      now += draw_ms;
+    }
+    now += scheduler_wait(&s, now);
+  }
+  printf("%7u %5u %7.1f", full_ms, s.fps, s.frame_avg / 16.0);
+  for(int32_t q=0; q<QUALITY_LEVELS; q++) printf(" %6u", at_level[q]);
+  printf("   %4.0f%%\n", 100.0 * level_ns[0] / level_ns[QUALITY_FULL]);
+}
+
+// ------------------------------------------------------------------------ //
+//  Streaming: walking through the world
+// ------------------------------------------------------------------------ //
+// The poses above jump all over the map, so every frame starts with a cold cache.  This walks the player
+// through the streamed world instead (turning at walls), the way it gets played, starting with an empty cache.
+#define WALK_FRAMES 2000
+
+static void run_stream(GContext *ctx, const char *name, bool prefetch) {
+  uint64_t total_ns = 0, worst_ns = 0;
+  scene_world();
+  options = defaults;
+  player = (PlayerStruct){.x=(64*(map_w/2)) + 96, .y=(64*(map_h/2)) + 96, .facing=10000};  // Where main.c starts
+  memset(&stats, 0, sizeof(stats));
+  for(int32_t f=0; f<WALK_FRAMES; f++) {
+    int32_t x = player.x, y = player.y;
+    walk(player.facing, 24);
+    if(player.x == x && player.y == y) player.facing += TRIG_MAX_ANGLE / 4 + 1000;  // Stuck: turn away
+    player.facing += 150;                                                             // Look around a bit as we go
+    host_context_clear(ctx);
+    uint64_t start = now_ns();
+    if(prefetch) prefetch_world(player.x, player.y, player.facing);
+    draw_3D(ctx, view);
+    uint64_t ns = now_ns() - start;
+    total_ns += ns;
+    if(ns > worst_ns) worst_ns = ns;
+  }
+  printf("%-10s %6d %10.0f %10.0f %10.0f %7.2f%% %9.2f %9.2f\n",
+         name, WALK_FRAMES, total_ns / (double)WALK_FRAMES, (double)worst_ns,
+         stats.chunk_lookups / (double)WALK_FRAMES, 100.0 * (1.0 - stats.chunk_stalls / (double)stats.chunk_lookups),
+         stats.chunk_stalls / (double)WALK_FRAMES, stats.chunk_prefetches / (double)WALK_FRAMES);
+}
+
+int main(int argc, char **argv) {
+  int opt;
+  while((opt = getopt(argc, argv, "n:s:o:")) != -1) {
+    switch(opt) {
+      case 'n': iterations = atoi(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0); break;
+      case 'o': dump_dir = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-n iterations] [-s seed] [-o dump_dir]\n", argv[0]);
+        return 1;
+    }
+  }
+  if(iterations < 1) iterations = 1;
+
+  GContext *ctx = host_context_create();
+  view = GRect(1, 25, 142, 128);
+  defaults = options;
+
+  printf("seed %u, %d iterations, view %dx%d\n", seed, (int)iterations, view.size.w, view.size.h);
+  printf("%-8s %-12s %6s %10s %8s %7s %8s %9s %9s  %s\n",
+         "scene", "config", "poses", "ns/frame", "ns/col", "rays/f", "steps/f", "wallpx/f", "floorpx/f", "checksum");
+  for(uint32_t s=0; s<sizeof(scenes)/sizeof(scenes[0]); s++)
+    for(uint32_t c=0; c<sizeof(configs)/sizeof(configs[0]); c++)
+      run(ctx, &scenes[s], &configs[c]);
+
+  printf("\nshoot_ray ns/ray: old traversal vs DDA (same face/dist/offset = DDA result matches old)\n");
+  printf("%-8s %6s %8s %8s %7s %6s %8s %8s %7s   %6s %6s %6s %4s\n",
+         "scene", "rays", "old", "dda", "saved", "long", "old", "dda", "saved", "face", "dist", "offset", "max");
+  for(uint32_t s=0; s<sizeof(scenes)/sizeof(scenes[0]); s++)
+    run_rays(&scenes[s]);
+
+  printf("\nspinning in place, %d frames of %d per start cell (same checksum = reusing rays changes nothing)\n", SPIN_FRAMES, SPIN_STEP);
+  printf("%-8s %-10s %10s %7s %8s  %s\n", "scene", "rays", "ns/frame", "rays/f", "steps/f", "checksum");
+  for(uint32_t s=0; s<sizeof(scenes)/sizeof(scenes[0]); s++) {
+    run_spin(ctx, &scenes[s], "every", false, false);
+    run_spin(ctx, &scenes[s], "coherent", true, false);
+    run_spin(ctx, &scenes[s], "reuse", true, true);
+  }
+
+  printf("\nline of sight, %d points per pose asking query_rays if they can see the player: ns/query without and with the view's seen squares (agree must be 100%%)\n", SIGHT_QUERIES);
+  printf("%-8s %8s %8s %8s %8s\n", "scene", "walk", "marks", "clear", "agree");
+  for(uint32_t s=0; s<sizeof(scenes)/sizeof(scenes[0]); s++)
+    run_sight(ctx, &scenes[s]);
+
+  printf("\nsprites on random open squares: ns/frame, ns/frame culling and drawing them, sprites left after culling, same without the seen squares\n");
+  printf("%-8s %7s %10s %10s %8s %10s  %-8s %s\n", "scene", "sprites", "ns/frame", "sprite ns", "drawn/f", "no marks", "checksum", "no marks");
+  static const int32_t sprite_counts[] = {0, 16, 128};
+  for(uint32_t s=0; s<sizeof(scenes)/sizeof(scenes[0]); s++) {
+    if(scenes[s].generate == scene_world || scenes[s].generate == scene_empty) continue;
+    for(uint32_t k=0; k<sizeof(sprite_counts)/sizeof(sprite_counts[0]); k++)
+      run_sprites(ctx, &scenes[s], sprite_counts[k]);
+  }
+
+  printf("\nper-stage profile, last %d frames: min avg p95 (us, rays)\n%-8s", PROFILE_FRAMES, "scene");
+  for(int32_t v=0; v<PROFILE_VALUES; v++) if(v != PROFILE_TEXT) printf(" %17s", profile_names[v]);
+  printf("\n");
+  for(uint32_t s=0; s<sizeof(scenes)/sizeof(scenes[0]); s++)
+    run_profile(ctx, &scenes[s]);
+
+  printf("\nminimap, %d frames of draw_map: ns per frame, every pixel vs cached (checksums must match)\n", MAP_FRAMES);
+  printf("%-8s %-8s %9s %9s %7s  %-8s %-8s\n", "scene", "motion", "pixels", "cached", "faster", "pixels", "cached");
+  for(uint32_t s=0; s<sizeof(scenes)/sizeof(scenes[0]); s++) {
+    if(scenes[s].generate == scene_empty || scenes[s].generate == scene_mirrors) continue;
+    run_map(ctx, &scenes[s], "still", MAP_BOX);
+    run_map(ctx, &scenes[s], "walking", MAP_BOX);
+    run_map(ctx, &scenes[s], "editing", MAP_BOX);
+  }
+  run_map(ctx, &scenes[0], "clipped", GRect(-20, 150, 40, 40));
+
+  printf("\nmaze generation, seed %u: ns per maze and per square, squares dug, dead ends (repeat = same seed again)\n", seed);
+  printf("%-9s %10s %8s %7s %6s  %-8s %s\n", "size", "ns/maze", "ns/sq", "open", "dead", "checksum", "repeat");
+  for(int32_t size=16; size<=MAP_MAX; size*=2)
+    run_maze(size);
+
+  printf("\nflow field, %d ticks walking with agents chasing: ns per tick, ticks where the player's square or the map changed, ns and squares visited per field worked out (check = same as from scratch)\n", FLOW_TICKS);
+  printf("%-6s %-9s %6s %10s %10s %8s %10s %9s %6s  %s\n", "map", "size", "agents", "update ns", "agents ns", "changed", "ns/build", "squares", "caught", "check");
+  static const int32_t flow_agents[] = {0, 16, 128};
+  for(int32_t size=16; size<=MAP_MAX; size*=2)
+    for(int32_t k=0; k<2; k++)
+      for(uint32_t a=0; a<sizeof(flow_agents)/sizeof(flow_agents[0]); a++)
+        run_flow(k ? "maze" : "random", size, flow_agents[a]);
+
+  printf("\nframe pacing, %dms of %dms ticks (error = simulation time gone missing)\n", PACE_MS, SIM_TICK_MS);
+  printf("%7s %6s %6s %7s %7s %7s %5s %7s %7s %6s\n", "draw ms", "sleep", "ticks", "frames", "dropped", "over", "fps", "avg ms", "lost ms", "error");
+  static const uint32_t draw_ms[] = {0, 10, 40, 60, 120, 400};
+  for(uint32_t i=0; i<sizeof(draw_ms)/sizeof(draw_ms[0]); i++)
+    run_pacing(draw_ms[i], 0);
+  run_pacing(10, 400);                 // Idling at main.c's IDLE_MAX_MS back-off
+
+  printf("\ntilt input, %d samples a second: main_loop peeking every tick vs batches of %d through the low-pass filter (latency target %dms)\n",
+         ACCEL_RATE_HZ, ACCEL_BATCH, ACCEL_LATENCY_MS);
+  printf("%6s %6s %7s %9s %8s %7s %7s %7s %7s\n", "noise", "peek/s", "batch/s", "moving", "moving", "jitter", "jitter", "ms", "ms");
+  static const int32_t tilt_noises[] = {0, 20, 40, 80};
+  for(uint32_t i=0; i<sizeof(tilt_noises)/sizeof(tilt_noises[0]); i++)
+    run_tilt(tilt_noises[i]);
+
+  printf("\nadaptive quality, %dms on a watch where full quality takes full ms (frames drawn at each level; q0 cost vs full)\n", PACE_MS);
+  printf("%7s %5s %7s %6s %6s %6s %6s   %5s\n", "full ms", "fps", "avg ms", "q0", "q1", "q2", "q3", "q0");
+  static const uint32_t full_ms[] = {20, 40, 60, 80, 120};
+  for(uint32_t i=0; i<sizeof(full_ms)/sizeof(full_ms[0]); i++)
+    run_adaptive(ctx, full_ms[i]);
+
+  printf("\nstreamed world, walking %d frames from a cold cache of %d chunks\n", WALK_FRAMES, CHUNK_CACHE);
+  printf("%-10s %6s %10s %10s %10s %8s %9s %9s\n",
+         "prefetch", "frames", "ns/frame", "worst ns", "lookups/f", "hit", "stalls/f", "loads/f");
+  run_stream(ctx, "off", false);
+  run_stream(ctx, "on", true);
+
+  destroy_map();
+  host_context_destroy(ctx);
+  return 0;
+}
@@ -0,0 +1,195 @@
+// ------------------------------------------------------------------------ //
+//  Host implementation of the Pebble SDK calls used by the engine
+// ------------------------------------------------------------------------ //
+#include "pebble.h"
+#include <math.h>
+#include <png.h>
+
+#ifndef RESOURCE_DIR
+#define RESOURCE_DIR "../resources"
+#endif
+
+// ------------------------------------------------------------------------ //
+//  Trig
+// ------------------------------------------------------------------------ //
+// One full-circle table built on first use.  Values are rounded exactly the
+// same way on every run, so benchmark frames are reproducible bit-for-bit.
+static int32_t sin_table[TRIG_MAX_ANGLE];
+static bool sin_table_ready = false;
+
+static void build_sin_table(void) {
+  for(int32_t i=0; i<TRIG_MAX_ANGLE; i++)
+    sin_table[i] = (int32_t)lround(sin(i * (2.0 * M_PI / TRIG_MAX_ANGLE)) * TRIG_MAX_RATIO);
+  sin_table_ready = true;
+}
+
+int32_t sin_lookup(int32_t angle) {
+  if(!sin_table_ready) build_sin_table();
+  return sin_table[angle & (TRIG_MAX_ANGLE - 1)];
+}
+
+int32_t cos_lookup(int32_t angle) {
+  return sin_lookup(angle + (TRIG_MAX_ANGLE / 4));
+}
+
+int32_t atan2_lookup(int16_t y, int16_t x) {
+  double a = atan2((double)y, (double)x);
+  if(a < 0) a += 2.0 * M_PI;
+  return ((int32_t)lround(a * (TRIG_MAX_ANGLE / (2.0 * M_PI)))) & (TRIG_MAX_ANGLE - 1);
+}
+
+// ------------------------------------------------------------------------ //
+//  Graphics
+// ------------------------------------------------------------------------ //
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {ctx->stroke_color = color;}
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {ctx->fill_color = color;}
+void graphics_context_set_text_color(GContext *ctx, GColor color) {ctx->text_color = color;}
+
+static void plot(GContext *ctx, int32_t x, int32_t y, GColor color) {
+  GBitmap *fb = &ctx->dest_bitmap;
+  if(color == GColorClear || x < 0 || y < 0 || x >= fb->bounds.size.w || y >= fb->bounds.size.h) return;
+  uint8_t *byte = (uint8_t*)fb->addr + y * fb->row_size_bytes + (x >> 3);
+  if(color == GColorWhite) *byte |= 1 << (x & 7); else *byte &= ~(1 << (x & 7));
+}
+
+void graphics_draw_pixel(GContext *ctx, GPoint point) {plot(ctx, point.x, point.y, ctx->stroke_color);}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  int32_t dx = abs(p1.x - p0.x), dy = -abs(p1.y - p0.y);
+  int32_t sx = p0.x < p1.x ? 1 : -1, sy = p0.y < p1.y ? 1 : -1;
+  int32_t err = dx + dy, x = p0.x, y = p0.y;
+  while(true) {
+    plot(ctx, x, y, ctx->stroke_color);
+    if(x == p1.x && y == p1.y) break;
+    int32_t e2 = 2 * err;
+    if(e2 >= dy) {err += dy; x += sx;}
+    if(e2 <= dx) {err += dx; y += sy;}
+  }
+}
+
+void graphics_draw_rect(GContext *ctx, GRect r) {
+  for(int32_t x=r.origin.x; x<r.origin.x + r.size.w; x++) {
+    plot(ctx, x, r.origin.y, ctx->stroke_color);
+    plot(ctx, x, r.origin.y + r.size.h - 1, ctx->stroke_color);
+  }
+  for(int32_t y=r.origin.y; y<r.origin.y + r.size.h; y++) {
+    plot(ctx, r.origin.x, y, ctx->stroke_color);
+    plot(ctx, r.origin.x + r.size.w - 1, y, ctx->stroke_color);
+  }
+}
+
+void graphics_fill_rect(GContext *ctx, GRect r, uint16_t corner_radius, GCornerMask corner_mask) {
+  for(int32_t y=r.origin.y; y<r.origin.y + r.size.h; y++)
+    for(int32_t x=r.origin.x; x<r.origin.x + r.size.w; x++)
+      plot(ctx, x, y, ctx->fill_color);
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if(tloc) *tloc = ts.tv_sec;
+  if(out_ms) *out_ms = (uint16_t)(ts.tv_nsec / 1000000);
+  return (uint16_t)(ts.tv_nsec / 1000000);
+}
+
+uint32_t host_clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+GContext *host_context_create(void) {
+  GContext *ctx = calloc(1, sizeof(GContext));
+  ctx->dest_bitmap.row_size_bytes = 20;
+  ctx->dest_bitmap.bounds = GRect(0, 0, 144, 168);
+  ctx->dest_bitmap.addr = calloc(168, 20);
+  ctx->stroke_color = ctx->fill_color = ctx->text_color = GColorWhite;
+  return ctx;
+}
+
+void host_context_destroy(GContext *ctx) {
+  free(ctx->dest_bitmap.addr);
+  free(ctx);
+}
+
+void host_context_clear(GContext *ctx) {
+  memset(ctx->dest_bitmap.addr, 0, ctx->dest_bitmap.row_size_bytes * ctx->dest_bitmap.bounds.size.h);
+}
+
+// ------------------------------------------------------------------------ //
+//  Resources
+// ------------------------------------------------------------------------ //
+static const char *resource_files[] = {
+  [RESOURCE_ID_ICON]  = "images/3DICON.png",
+  [RESOURCE_ID_WORLD] = "data/world.bin",
+};
+
+static char resource_paths[sizeof(resource_files) / sizeof(resource_files[0])][512];
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  if(resource_id >= sizeof(resource_files) / sizeof(resource_files[0]) || !resource_files[resource_id]) return NULL;
+  snprintf(resource_paths[resource_id], sizeof(resource_paths[0]), "%s/%s", RESOURCE_DIR, resource_files[resource_id]);
+  return resource_paths[resource_id];
+}
+
+size_t resource_size(ResHandle h) {
+  FILE *f = h ? fopen(h, "rb") : NULL;
+  if(!f) return 0;
+  fseek(f, 0, SEEK_END);
+  size_t size = ftell(f);
+  fclose(f);
+  return size;
+}
+
+// Opens the file every time, like the watch reading from flash: loads stay expensive
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes) {
+  FILE *f = h ? fopen(h, "rb") : NULL;
+  if(!f) return 0;
+  size_t got = fseek(f, start_offset, SEEK_SET) == 0 ? fread(buffer, 1, num_bytes, f) : 0;
+  fclose(f);
+  return got;
+}
+
+// Converts the PNG the way the SDK's bitmap generator does for 1-bit
+// resources: luminance >= 50% is white, transparent pixels are black.
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  char path[512];
+  if(resource_id >= sizeof(resource_files) / sizeof(resource_files[0]) || !resource_files[resource_id]) return NULL;
+  snprintf(path, sizeof(path), "%s/%s", RESOURCE_DIR, resource_files[resource_id]);
+
+  png_image image;
+  memset(&image, 0, sizeof(image));
+  image.version = PNG_IMAGE_VERSION;
+  if(!png_image_begin_read_from_file(&image, path)) {
+    fprintf(stderr, "gbitmap_create_with_resource: %s: %s\n", path, image.message);
+    return NULL;
+  }
+  image.format = PNG_FORMAT_RGBA;
+  uint8_t *rgba = malloc(PNG_IMAGE_SIZE(image));
+  if(!png_image_finish_read(&image, NULL, rgba, 0, NULL)) {
+    fprintf(stderr, "gbitmap_create_with_resource: %s: %s\n", path, image.message);
+    free(rgba);
+    return NULL;
+  }
+
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->row_size_bytes = ((image.width + 31) / 32) * 4;
+  bitmap->bounds = GRect(0, 0, image.width, image.height);
+  bitmap->addr = calloc(image.height, bitmap->row_size_bytes);
+  for(uint32_t y=0; y<image.height; y++)
+    for(uint32_t x=0; x<image.width; x++) {
+      uint8_t *p = rgba + (y * image.width + x) * 4;
+      uint32_t luma = (p[0] * 299 + p[1] * 587 + p[2] * 114) / 1000;
+      if(p[3] >= 128 && luma >= 128)
+        ((uint8_t*)bitmap->addr)[y * bitmap->row_size_bytes + (x >> 3)] |= 1 << (x & 7);
+    }
+  free(rgba);
+  png_image_free(&image);
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if(!bitmap) return;
+  free(bitmap->addr);
+  free(bitmap);
+}
@@ -0,0 +1,88 @@
+#pragma once
+// ------------------------------------------------------------------------ //
+//  Host stand-in for the Pebble SDK 2 header
+// ------------------------------------------------------------------------ //
+// Just enough of pebble.h for map.c, ray.c and draw.c to compile on Linux so
+// the renderer can be benchmarked off the watch.  main.c (windows, buttons,
+// timers, accelerometer service) is not part of the host build.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+int32_t atan2_lookup(int16_t y, int16_t x);
+
+typedef struct GPoint { int16_t x, y; } GPoint;
+typedef struct GSize  { int16_t w, h; } GSize;
+typedef struct GRect  { GPoint origin; GSize size; } GRect;
+#define GPoint(x, y) ((GPoint){(x), (y)})
+#define GSize(w, h) ((GSize){(w), (h)})
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+
+typedef enum GColor { GColorClear = ~0, GColorBlack = 0, GColorWhite = 1 } GColor;
+typedef enum GCornerMask { GCornerNone = 0 } GCornerMask;
+
+// 1-bit, LSB-first, rows padded to 32-bit words -- same as the watch
+typedef struct GBitmap {
+  void *addr;
+  uint16_t row_size_bytes;
+  uint16_t info_flags;
+  GRect bounds;
+} GBitmap;
+
+// The engine casts GContext* to GBitmap* to reach the framebuffer, so the
+// framebuffer bitmap has to be the first member (as it is on the watch).
+typedef struct GContext {
+  GBitmap dest_bitmap;
+  GColor stroke_color;
+  GColor fill_color;
+  GColor text_color;
+} GContext;
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_draw_pixel(GContext *ctx, GPoint point);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
+void graphics_draw_rect(GContext *ctx, GRect rect);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+// Accelerometer samples (input.c filters them; the host benchmark makes them up)
+typedef struct AccelData {
+  int16_t x, y, z;            // milli-g
+  bool did_vibrate;
+  uint64_t timestamp;
+} AccelData;
+typedef enum {ACCEL_SAMPLING_10HZ = 10, ACCEL_SAMPLING_25HZ = 25, ACCEL_SAMPLING_50HZ = 50, ACCEL_SAMPLING_100HZ = 100} AccelSamplingRate;
+
+// Resource ids mirror the "media" list in appinfo.json
+typedef enum {
+  RESOURCE_ID_ICON = 1,
+  RESOURCE_ID_WORLD,
+} ResourceId;
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+void gbitmap_destroy(GBitmap *bitmap);
+
+typedef void *ResHandle;                          // Host: the resource's file path
+ResHandle resource_get_handle(uint32_t resource_id);
+size_t resource_size(ResHandle h);
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes);
+
+// ------------------------------------------------------------------------ //
+//  Host-only helpers (not part of the Pebble SDK)
+// ------------------------------------------------------------------------ //
+GContext *host_context_create(void);              // 144x168 framebuffer, cleared to black
+void host_context_destroy(GContext *ctx);
+void host_context_clear(GContext *ctx);
+uint32_t host_clock_us(void);                     // Monotonic clock for the profiler (the watch only has ms)
+#define PROFILE_CLOCK_US() host_clock_us()
@@ -0,0 +1,743 @@
+#include "main.h"
+
+//----------------------------------//
+// Viewing Window Size and Position //
+//----------------------------------//
+// beneficial to: (set fov as divisible by view_w) and (have view_w evenly divisible by 2)
+// e.g.: view_w=144 is good since 144/2=no remainder. Set fov = 13104fov (since it = 144w x 91 and is close to 20% of 65536)
+
+// Full Screen (You should also comment out drawing the text box)
+//#define view_x 0             // View Left Edge
+//#define view_y 0             // View Top Edge
+//#define view_w 144           // View Width in pixels
+//#define view_h 168           // View Hight in pixels
+//#define fov 13104            // Field of view angle (20% of a circle is good) (TRIG_MAX_RATIO = 0x10000 or 65536) * 20%
+
+// Smaller square
+//#define view_x 20            // View Left Edge
+//#define view_y 30            // View Top Edge
+//#define view_w 100           // View Width in pixels
+//#define view_h 100           // View Hight in pixels
+//#define fov 13100            // Field of view angle (20% of a circle is good) (TRIG_MAX_RATIO = 0x10000 or 65536) * 20%
+
+//Nearly full screen
+//#define fov 13064              // Field of view angle (20% of a circle is good) (TRIG_MAX_RATIO = 0x10000 or 65536) * 20%
+
+
+//----------------------------------//
+//#define fov_over_w fov/view_w  // Do math now so less during execution
+//#define half_view_w view_w/2   //
+//#define half_view_h view_h/2
+//----------------------------------//
+
+
+int32_t view_x =     1;             // View Left Edge
+int32_t view_y =    25;             // View Top Edge
+int32_t view_w =   142;             // View Width in pixels
+int32_t view_h =   128;             // View Hight in pixels
+GRect view;
+int32_t    fov = 10650;             // Field of view angle (20% of a circle is good) (TRIG_MAX_RATIO = 0x10000 or 65536) * 20%
+
+OptionsStruct options = {           // Render path switches (the host benchmark flips these to compare paths)
+  .dda = true,
+  .floor_rows = true,
+  .batched = true,
+  .coherent = true,
+  .reuse = true,
+  .range = RANGE,
+  .fog = RANGE,                     // No fog
+  .cached_map = true,
+  .render = RENDER_TEXTURED,
+  .quality = QUALITY_FULL,
+  .seen_cells = true,
+};
+
+#if defined(ENGINE_STATS) || defined(ENGINE_PROFILE)
+StatsStruct stats;
+#endif
+
+//----------------------------------//
+// Column and Row Tables            //
+//----------------------------------//
+// Everything draw_3D needs per column or per row that only depends on the view and fov.
+// update_tables() rebuilds them when either changes, so the per-pixel loops need no trig at all.
+// Column rays go through evenly spaced points on a camera plane 1 unit in front of the player
+// (instead of evenly spaced angles), so each ray is facing + plane * column: two multiplies, no lookups.
+#define MAX_VIEW_W 144
+#define MAX_VIEW_H 168
+
+typedef struct ColumnStruct {
+  int32_t angle;              // Angle from the center of view to this column's ray (for shoot_ray)
+  int32_t cos;                // cos(angle): ray length * cos = distance from the camera plane (un-fisheye)
+  int32_t plane;              // Sideways offset of the ray on the camera plane (x TRIG_MAX_RATIO)
+} ColumnStruct;
+
+static ColumnStruct column[MAX_VIEW_W];
+static int32_t floor_dist[MAX_VIEW_H/2];   // Distance to the floor seen i pixels below the center of view
+static int32_t table_w = 0, table_h = 0, table_fov = 0;
+static int32_t plane_half;                 // Half width of the camera plane: tan(fov/2) (x TRIG_MAX_RATIO)
+static int32_t wall_half[MAX_VIEW_W];      // Per frame: how far each column's wall reaches from the center row
+static int32_t floor_fog[MAX_VIEW_H/2];    // Per frame: fog_level of floor_dist[i]
+static int32_t wall_depth[MAX_VIEW_W];     // Per frame: each column's wall distance from the camera plane, INT32_MAX if nothing's in range
+static int16_t span_top[MAX_VIEW_W], span_bottom[MAX_VIEW_W];  // Per frame: rows the shaded and wireframe paths fill in each column
+static uint8_t span_bits[MAX_VIEW_W];      //   and their dither (bit y&3: view row y shows), 0 = nothing
+static uint32_t span_on[MAX_VIEW_H + 1], span_off[MAX_VIEW_H + 1];  // fill_spans: columns whose span starts / ends at each row (static: the stack is small)
+
+static void update_tables(GRect box) {
+  if(box.size.w == table_w && box.size.h == table_h && fov == table_fov) return;
+  table_w = box.size.w; table_h = box.size.h; table_fov = fov;
+
+  plane_half = ((int64_t)sin_lookup(fov/2) << 16) / cos_lookup(fov/2);
+  for(int32_t col=0; col<box.size.w; col++) {
+    column[col].plane = (2 * (col - (box.size.w>>1)) * plane_half) / box.size.w;
+    column[col].angle = atan2_lookup(column[col].plane >> 2, TRIG_MAX_RATIO >> 2);
+    if(column[col].angle > TRIG_MAX_ANGLE/2) column[col].angle -= TRIG_MAX_ANGLE;
+    column[col].cos = cos_lookup(column[col].angle);
+  }
+
+  // Floor i pixels below center: wall height at distance d is (h*64)/d, so d = (h*64)/(2*i)
+  for(int32_t i=0; i<box.size.h/2; i++)
+    floor_dist[i] = (box.size.h * 32) / (i>0 ? i : 1);
+}
+
+//----------------------------------//
+// Distance Fog                     //
+//----------------------------------//
+// Past options.fog, walls and floor fade out to black at options.range through a 4x4 ordered dither.
+// fog_level(dist) is how many of the 16 pixels in each 4x4 block still show: 16 = no fog, 0 = black.
+static const uint8_t bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+static int32_t fog_level(int32_t dist) {
+  if(dist <= options.fog) return 16;
+  if(dist >= options.range) return 0;
+  return (16 * (options.range - dist)) / (options.range - options.fog);
+}
+
+// Pixels of view row y that show at this fog level, as a framebuffer word (the pattern repeats every 4 columns)
+static inline uint32_t fog_row(int32_t level, int32_t y) {
+  uint32_t bits = 0;
+  if(level >= 16) return 0xFFFFFFFF;
+  for(int32_t x=0; x<4; x++) if(bayer[y & 3][x] < level) bits |= 1 << x;
+  return bits * 0x11111111;
+}
+
+// Pixels of screen column x that show at this fog level: bit y&3 is view row y
+static uint32_t fog_column(int32_t level, int32_t x) {
+  uint32_t bits = 0;
+  for(int32_t y=0; y<4; y++) if(bayer[y][x & 3] < level) bits |= 1 << y;
+  return bits;
+}
+
+//----------------------------------//
+// Quality Levels                   //
+//----------------------------------//
+// Cheaper ways to draw the view, for when frames run over budget (options.quality, picked by schedule.c).
+// col_step: only every col_step'th screen column (1, 2 or 4) gets a ray and gets drawn, the ones between copy it.
+// floor_step: floor/ceiling is worked out every floor_step rows and copied to the rows between, 0 = not drawn at all.
+typedef struct QualityStruct {
+  uint8_t col_step;
+  uint8_t floor_step;
+} QualityStruct;
+
+#define MAX_FLOOR_STEP 2              // Largest floor_step below (draw_floor_rows keeps this many rows' bits at once)
+static const QualityStruct qualities[QUALITY_LEVELS] = {
+  {4, 0},                     // 0: blocky walls, no floor or ceiling
+  {2, 2},                     // 1: half resolution
+  {1, 2},                     // 2: floor/ceiling at half height resolution
+  {1, 1},                     // 3 (QUALITY_FULL): everything
+};
+static QualityStruct quality;               // This frame's
+static int32_t key_from;                    // First screen column where col_step starts (the view's columns before it all get drawn)
+
+// Whether view column col gets drawn (otherwise it copies the one on its left).  Every column of a
+// framebuffer word's col_step-aligned group copies the first, so columns never copy across words.
+static inline bool key_column(GRect box, int32_t col) {
+  int32_t x = box.origin.x + col;
+  return x < key_from || (x & (quality.col_step - 1)) == 0;
+}
+
+//widen_columns(dst, stride, word0, box, col0, col1)
+//  Copies each drawn column into the blank col_step-1 columns to its right, a word per row at a time:
+//  with the drawn columns' bits spaced col_step apart, multiplying by col_step 1s smears each one across its group.
+//  dst, stride, word0 = where to draw, same as draw_floor_rows
+static void widen_columns(uint32_t *dst, int32_t stride, int32_t word0, GRect box, int32_t col0, int32_t col1) {
+  uint32_t step = quality.col_step, ones = (1u << step) - 1, aligned = 0xFFFFFFFF / ones;  // 0x55555555 or 0x11111111
+  if(step == 1) return;
+  for(int32_t x0=box.origin.x+col0, x1=box.origin.x+col1, word=x0>>5; word<=(x1-1)>>5; word++) {
+    int32_t lo = x0 > word*32 ? x0 - word*32 : 0, hi = x1 < word*32+32 ? x1 - word*32 : 32;
+    uint32_t in_view = (hi - lo == 32) ? 0xFFFFFFFF : ((1u << (hi - lo)) - 1) << lo;
+    uint32_t from = aligned & in_view, *row = dst + word - word0;  // (the view's columns before key_from aren't aligned)
+    for(int32_t y=0; y<box.size.h; y++, row+=stride) *row |= ((*row & from) * ones) & in_view;
+  }
+}
+
+//uint8_t texture_point(int8_t hit, int32_t x, int32_t y) {
+//  ((*target>> ((31-((i<<6)/colheight))))&1)
+//}
+
+void fill_window(GContext *ctx, uint8_t *data) {
+  for(uint16_t y=0, yaddr=0; y<168; y++, yaddr+=20)
+    for(uint16_t x=0; x<19; x++)
+      ((uint8_t*)(((GBitmap*)ctx)->addr))[yaddr+x] = data[y%8];
+}
+
+// Rows a wall perp away covers in a view h high (clipped to the view).  Returns half of its height.
+static inline int32_t wall_rows(int32_t perp, int32_t h, int32_t *top, int32_t *bottom) {
+  int32_t center = h/2, half;
+  if(perp < 1) perp = 1;             // Up against the wall
+  half = ((h << 6) / perp) / 2;      // Half of the wall height = view height * 64 (wall height) / distance
+  *top = center - half + 1;    if(*top < 0) *top = 0;
+  *bottom = center + half - 1; if(*bottom > h - 1) *bottom = h - 1;
+  return half;
+}
+
+//draw_wall(dst, stride, xbit, texture, perp, h, fog)
+//  Draws one textured wall column, stepping through the texture in 16.16 fixed point: one divide per column, adds per pixel.
+//  dst = framebuffer word holding the view's top row in this column, stride = words per framebuffer row
+//  xbit = bit of the word this column is in, texture = 2 words of texture column (texel 0 = top of wall)
+//  perp = distance to the wall from the camera plane, h = view height
+//  fog = fog_column pattern for this column (15 = no fog)
+//  Walls taller than the view start part way into the texture instead of being squished to fit.
+// returns how far the wall reaches from the center row (where floor and ceiling start)
+static int32_t draw_wall(uint32_t *dst, int32_t stride, uint32_t xbit, const uint32_t *texture, int32_t perp, int32_t h, uint32_t fog) {
+  int32_t center = h/2, half, top, bottom, v, step;
+
+  if(perp < 1) perp = 1;
+  half = wall_rows(perp, h, &top, &bottom);
+  step = ((uint32_t)perp << 16) / h;                  // Texels per pixel: wall is h*64/perp pixels for 64 texels
+  v = (32 << 16) + (top - center) * step;             // Texel 32 is at the center row
+  dst += top * stride;
+  STAT(wall_pixels, bottom - top + 1);
+  // Note: "|=" only sets bits, so this still assumes a black background.
+  if(fog == 15)
+    for(int32_t y=top; y<=bottom; y++, dst+=stride, v+=step)
+      *dst |= ((texture[(v >> 21) & 1] >> ((v >> 16) & 31)) & 1) << xbit;
+  else
+    for(int32_t y=top; y<=bottom; y++, dst+=stride, v+=step)
+      *dst |= ((texture[(v >> 21) & 1] >> ((v >> 16) & 31)) & (fog >> (y & 3)) & 1) << xbit;
+
+  return half < center ? half : center;
+}
+
+//draw_floor_rows(dst, stride, word0, box, col0, col1, dirx, diry)
+//  Floor and ceiling a row at a time, instead of down each column.  Every pixel in a row is the same distance
+//  away, so the spot on the floor just steps evenly from the left edge ray to the right edge ray: adds per pixel.
+//  Floor row i below center and ceiling row i above it are the same distance away, so they share the work.
+//  Only fills columns whose wall doesn't reach row i (wall_half[] is filled in by draw_columns).
+//  Rows past options.range are skipped, rows in the fog are dithered a word at a time.
+//  At lower quality only drawn columns are filled in, and each row worked out fills quality.floor_step rows.
+//  dst, stride, word0 = where to draw: dst[y*stride + (x>>5) - word0] is the word for view row y, screen column x
+//  col0, col1 = range of view columns to draw
+static void draw_floor_rows(uint32_t *dst, int32_t stride, int32_t word0, GRect box, int32_t col0, int32_t col1, int32_t dirx, int32_t diry) {
+  int32_t center = box.size.h/2, first = center, x0 = box.origin.x + col0, step = quality.floor_step;
+  int32_t leftx  = dirx + (((int64_t)diry * plane_half) >> 16), lefty  = diry - (((int64_t)dirx * plane_half) >> 16);  // Left edge ray
+  int32_t rightx = dirx - (((int64_t)diry * plane_half) >> 16), righty = diry + (((int64_t)dirx * plane_half) >> 16);  // Right edge ray
+
+  const uint32_t *floor = materials[0].floor, *ceiling = materials[0].ceiling;
+  for(int32_t col=col0; col<col1; col++) if(wall_half[col] < first) first = wall_half[col];  // Rows above this are all wall
+
+  for(int32_t i=first - first % step; i<center; i+=step) {  // Rows i to last share the floor worked out for row i
+    int32_t last = i + step - 1 < center ? i + step - 1 : center - 1, rows = last - i + 1;
+    if(floor_fog[last] == 0) continue;  // Too far away to see
+    int32_t dist = floor_dist[i];
+    uint32_t floor_fog_bits[MAX_FLOOR_STEP], ceiling_fog_bits[MAX_FLOOR_STEP];
+    for(int32_t j=0; j<rows; j++) {
+      floor_fog_bits[j] = fog_row(floor_fog[i + j], center + i + j);
+      ceiling_fog_bits[j] = fog_row(floor_fog[i + j], center - i - j);
+    }
+    int32_t stepx = (dist * (rightx - leftx)) / box.size.w, mapx = (player.x << 16) + dist * leftx + col0 * stepx;  // 16.16 position on map
+    int32_t stepy = (dist * (righty - lefty)) / box.size.w, mapy = (player.y << 16) + dist * lefty + col0 * stepy;
+    uint32_t *floor_row   = dst + (center + i) * stride + (x0 >> 5) - word0;
+    uint32_t *ceiling_row = dst + (center - i) * stride + (x0 >> 5) - word0;
+    uint32_t bit = 1u << (x0 & 31), floor_bits = 0, ceiling_bits = 0, open[MAX_FLOOR_STEP] = {0};  // Pixels are collected a word at a time (open[j]: columns where row i+j isn't wall)
+
+    for(int32_t col=col0; col<col1; col++, mapx+=stepx, mapy+=stepy) {
+      if(last >= wall_half[col] && (quality.col_step == 1 || key_column(box, col)) && floor_at(mapx >> 22, mapy >> 22)) {
+        uint32_t texturex = (mapx >> 16) & 63, texturey = (mapy >> 16) & 31;
+        STAT(floor_pixels, 2);
+        if((floor[texturex * 2] >> texturey) & 1) floor_bits |= bit;
+        if((ceiling[texturex * 2] >> texturey) & 1) ceiling_bits |= bit;
+        for(int32_t j=wall_half[col] > i ? wall_half[col] - i : 0; j<rows; j++) open[j] |= bit;
+      }
+      bit <<= 1;
+      if(bit == 0) {  // Word full: write it to each row and move to the next one
+        for(int32_t j=0; j<rows; j++) {
+          floor_row[j * stride]    |= floor_bits & open[j] & floor_fog_bits[j];
+          ceiling_row[-j * stride] |= ceiling_bits & open[j] & ceiling_fog_bits[j];
+          open[j] = 0;
+        }
+        floor_row++; ceiling_row++;
+        floor_bits = ceiling_bits = 0; bit = 1;
+      }
+    }
+    if(bit != 1)
+      for(int32_t j=0; j<rows; j++) {
+        floor_row[j * stride]    |= floor_bits & open[j] & floor_fog_bits[j];
+        ceiling_row[-j * stride] |= ceiling_bits & open[j] & ceiling_fog_bits[j];
+      }
+  }
+}
+
+//----------------------------------//
+// Ray Casting                      //
+//----------------------------------//
+// What each view column's ray hit.  Two frames are kept: when the player has only turned since the last frame
+// (same spot, same map), a column whose ray lies between two of last frame's rays that hit the same face
+// is worked out from that face instead of being cast again (see reuse_column).
+#define COHERENT_SPAN 8               // Columns between the rays options.coherent starts with
+
+typedef struct ColumnRayStruct {
+  RayStruct ray;              // What it hit
+  int32_t dirx, diry;         // Direction it was shot in (the cache key: an absolute angle, exactly)
+  int8_t hit;                 // What shoot_ray returned
+} ColumnRayStruct;
+
+static ColumnRayStruct col_rays[2][MAX_VIEW_W];
+static ColumnRayStruct *cols = col_rays[0];   // This frame
+static ColumnRayStruct *prev = col_rays[1];   // Last frame
+static int32_t prev_w = 0;                    // Columns in last frame (0 = can't reuse it)
+static int32_t traced_w = 0;                  // Columns in this frame, once it's traced
+static int32_t prev_x, prev_y;                // Where the player was
+static uint32_t prev_map;                     // map_changes then
+static int32_t prev_range, prev_fog;          // options.range and fog then (rays past the range were cut off)
+static int32_t prev_col;                      // reuse_column's place in last frame (columns go left to right)
+
+// Shoots column col's ray (cols[col].dirx, diry) into cols[col]
+static void cast_column(int32_t col) {
+  if(options.dda)
+    cols[col].hit = shoot_ray_dda(player.x, player.y, cols[col].dirx, cols[col].diry);
+  else
+    cols[col].hit = shoot_ray(player.x, player.y, player.facing + column[col].angle);
+  cols[col].ray = ray;
+}
+
+// Both rays went straight (no mirrors) to the same face of the same square
+static bool same_face(const ColumnRayStruct *a, const ColumnRayStruct *b) {
+  return a->hit >= 0 && a->hit == b->hit && a->ray.bounces == 0 && b->ray.bounces == 0 && a->ray.face == b->ray.face &&
+         (a->ray.x >> 6) == (b->ray.x >> 6) && (a->ray.y >> 6) == (b->ray.y >> 6);
+}
+
+//face_column(col, from)
+//  Fills in column col's ray from a ray that hit the same face, without walking the grid: the face is a
+//  known line, so the hit is where col's ray crosses it.  Same formulas as shoot_ray_dda, so the same result.
+//  Only for a ray between two rays that hit the same face: nothing can be in front of the face between them,
+//  since the gap is narrower than a square.  Returns false if col's ray misses the square (rounding at its corner),
+//  or is out of range, and it has to be cast after all.
+static bool face_column(int32_t col, const RayStruct *from) {
+  int32_t rayx = cols[col].dirx, rayy = cols[col].diry;
+  RayStruct r = *from;
+
+  if(r.face & 1) {                 // North or south face: crossing y = from->y
+    if((rayy > 0) != (r.face == 1)) return false;
+    r.x = player.x + ((r.y - player.y) * rayx) / rayy;
+    r.dist = ((r.y - player.y) << 16) / rayy;
+    if((r.x >> 6) != (from->x >> 6)) return false;
+    r.offset = r.x&63;
+  } else {                         // West or east face: crossing x = from->x
+    if((rayx > 0) != (r.face == 0)) return false;
+    r.y = player.y + ((r.x - player.x) * rayy) / rayx;
+    r.dist = ((r.x - player.x) << 16) / rayx;
+    if((r.y >> 6) != (from->y >> 6)) return false;
+    r.offset = r.y&63;
+  }
+  if(r.dist > (uint32_t)options.range) return false;
+  cols[col].ray = r;
+  cols[col].hit = r.hit != VOID_BLOCK;
+  return true;
+}
+
+// Columns a and b are cast: fills in the ones between.  If both hit the same face the ones between are worked out
+// from it, otherwise the middle column gets cast and each half goes again.
+static void trace_span(int32_t a, int32_t b) {
+  if(b - a < 2) return;
+  if(same_face(&cols[a], &cols[b])) {
+    for(int32_t col=a+1; col<b; col++)
+      if(!face_column(col, &cols[a].ray)) cast_column(col);
+    return;
+  }
+  int32_t mid = (a + b) / 2;
+  cast_column(mid);
+  trace_span(a, mid);
+  trace_span(mid, b);
+}
+
+// Casts view columns col0 up to col1 (a ray each, or only at span edges with options.coherent)
+static void cast_columns(int32_t col0, int32_t col1) {
+  if(!options.coherent || !options.dda) {
+    for(int32_t col=col0; col<col1; col++) cast_column(col);
+    return;
+  }
+  cast_column(col0);
+  for(int32_t a=col0, b; a<col1-1; a=b) {
+    b = a + COHERENT_SPAN; if(b > col1-1) b = col1-1;
+    cast_column(b);
+    trace_span(a, b);
+  }
+}
+
+static inline int64_t cross(int32_t ax, int32_t ay, int32_t bx, int32_t by) {return (int64_t)ax * by - (int64_t)ay * bx;}  // > 0: b is anticlockwise of a
+
+//reuse_column(col)
+//  Fills in column col from last frame if it can: the same direction exactly (copy it), or between two
+//  of last frame's rays that hit the same face (face_column).  Returns false if it needs casting.
+static bool reuse_column(int32_t col) {
+  int32_t x = cols[col].dirx, y = cols[col].diry;
+  // Columns go anticlockwise from left to right, so last frame's ray just clockwise of this one only moves right
+  while(prev_col + 1 < prev_w && cross(prev[prev_col + 1].dirx, prev[prev_col + 1].diry, x, y) >= 0) prev_col++;
+  const ColumnRayStruct *a = &prev[prev_col], *b = &prev[prev_col + 1];
+  if(a->dirx == x && a->diry == y) {cols[col].hit = a->hit; cols[col].ray = a->ray; return true;}
+  if(prev_col + 1 >= prev_w || cross(a->dirx, a->diry, x, y) <= 0 || cross(x, y, b->dirx, b->diry) <= 0 || !same_face(a, b)) return false;
+  return face_column(col, &a->ray);
+}
+
+// Fills cols[] for view columns col0 up to col1: reused from last frame where it can be, the rest cast.
+// At lower quality, columns that don't get drawn copy the ray on their left, direction and all,
+// so next frame can still reuse them.
+static void trace_columns(GRect box, int32_t col0, int32_t col1, int32_t dirx, int32_t diry) {
+  for(int32_t col=col0; col<col1; col++) {
+    cols[col].dirx = dirx - (((int64_t)diry * column[col].plane) >> 16);  // Ray direction = facing + camera plane offset
+    cols[col].diry = diry + (((int64_t)dirx * column[col].plane) >> 16);  //   (not a unit vector: length is 1/cos)
+  }
+  if(quality.col_step > 1) {
+    for(int32_t col=col0; col<col1; col++)
+      if(!key_column(box, col)) cols[col] = cols[col-1];  // (col0 is always drawn)
+      else if(prev_w == 0 || !reuse_column(col)) cast_column(col);
+    return;
+  }
+  if(prev_w == 0) {cast_columns(col0, col1); return;}
+
+  int32_t run = -1;  // First column of a run that couldn't be reused
+  for(int32_t col=col0; col<col1; col++) {
+    if(reuse_column(col)) {
+      if(run >= 0) cast_columns(run, col);
+      run = -1;
+    } else if(run < 0) {
+      run = col;
+    }
+  }
+  if(run >= 0) cast_columns(run, col1);
+}
+
+// Called at the start of each frame: swaps this frame's rays into last frame's, keeping them if only the facing changed
+static void start_trace(GRect box) {
+  ColumnRayStruct *last = cols;
+  bool keep = options.reuse && options.dda && traced_w == box.size.w && player.x == prev_x && player.y == prev_y && map_changes == prev_map &&
+              options.range == prev_range && options.fog == prev_fog;
+  keep = begin_seen(player.x, player.y) && keep;  // Rays cast from here on mark the squares they go through (reused ones don't)
+  cols = prev; prev = last;
+  prev_w = keep ? traced_w : 0;
+  prev_col = 0;
+}
+
+// Called at the end of each frame: remembers where it was cast from
+static void end_trace(GRect box) {
+  traced_w = box.size.w;
+  prev_x = player.x; prev_y = player.y;
+  prev_map = map_changes;
+  prev_range = options.range; prev_fog = options.fog;
+  end_seen();
+}
+
+//----------------------------------//
+// Render Paths                     //
+//----------------------------------//
+// How the view gets drawn (options.render).  draw_columns calls wall() for every drawn column whose ray hit a block,
+// then finish(), if there is one, for all the columns it just did.  Floor and ceiling are only drawn with floor set.
+//   wall(dst, stride, col, x, ray, perp, h): dst = word holding the view's top row in screen column x (view column col),
+//   perp = distance from the camera plane, h = view height.  Returns how far the wall reaches from the center row.
+//   finish(dst, stride, word0, box, col0, col1): same as draw_floor_rows
+typedef struct RenderPathStruct {
+  int32_t (*wall)(uint32_t *dst, int32_t stride, int32_t col, int32_t x, const RayStruct *ray, int32_t perp, int32_t h);
+  void (*finish)(uint32_t *dst, int32_t stride, int32_t word0, GRect box, int32_t col0, int32_t col1);
+  bool floor;
+} RenderPathStruct;
+
+static int32_t wall_textured(uint32_t *dst, int32_t stride, int32_t col, int32_t x, const RayStruct *ray, int32_t perp, int32_t h) {
+  int32_t fog = fog_level(perp);
+  return draw_wall(dst, stride, x & 31, material(ray->hit)->wall + ray->offset * 2, perp, h, fog < 16 ? fog_column(fog, x) : 15);
+}
+
+// Flat walls: lighter the closer they are, north and south faces a bit darker so corners show, and faded by fog.
+// Only the wall's rows and dither are noted here, fill_spans draws them.
+static int32_t wall_shaded(uint32_t *dst, int32_t stride, int32_t col, int32_t x, const RayStruct *ray, int32_t perp, int32_t h) {
+  int32_t top, bottom, half = wall_rows(perp, h, &top, &bottom);
+  int32_t level = (16 * 256) / ((perp > 0 ? perp : 0) + 256);  // 16 up close, half as bright 4 squares away
+  if(ray->face & 1) level = (level * 3) / 4;
+  span_top[col] = top; span_bottom[col] = bottom;
+  span_bits[col] = fog_column((level * fog_level(perp)) / 16, x);
+  STAT(wall_pixels, bottom - top + 1);
+  return half < h/2 ? half : h/2;
+}
+
+// Edges only: a dot at the top and bottom of each wall column, and the whole column (as tall as the nearer of the two)
+// where it isn't the same face of the same block as the column on its left.
+// A wall's right edge against nothing at all (out of range) isn't drawn.
+static int32_t wall_wireframe(uint32_t *dst, int32_t stride, int32_t col, int32_t x, const RayStruct *ray, int32_t perp, int32_t h) {
+  int32_t top, bottom, center = h/2, half = wall_rows(perp, h, &top, &bottom);
+  uint32_t fog = fog_column(fog_level(perp), x);
+  const RayStruct *left = &cols[col > 0 ? col - 1 : 0].ray;
+  if(half > center) half = center;
+  if(col > 0 && (left->hit != ray->hit || left->face != ray->face || (left->x >> 6) != (ray->x >> 6) || (left->y >> 6) != (ray->y >> 6))) {
+    int32_t edge = wall_half[col - 1] > half ? wall_half[col - 1] : half;
+    span_top[col] = center - edge + 1 > 0 ? center - edge + 1 : 0;
+    span_bottom[col] = center + edge - 1 < h - 1 ? center + edge - 1 : h - 1;
+    span_bits[col] = fog;
+    STAT(wall_pixels, span_bottom[col] - span_top[col] + 1);
+  } else if(half < center) {  // Top and bottom, unless they're off the view
+    dst[top * stride] |= ((fog >> (top & 3)) & 1) << (x & 31);
+    dst[bottom * stride] |= ((fog >> (bottom & 3)) & 1) << (x & 31);
+    STAT(wall_pixels, 2);
+  }
+  return half;
+}
+
+// Draws the spans wall_shaded and wall_wireframe noted, a framebuffer word at a time: going down the rows, a column's bit
+// turns on at its top row and off past its bottom row, so each row is one word (whichever columns cover it) through the dither.
+static void fill_spans(uint32_t *dst, int32_t stride, int32_t word0, GRect box, int32_t col0, int32_t col1) {
+  uint32_t *on = span_on, *off = span_off;
+  for(int32_t x0=box.origin.x+col0, x1=box.origin.x+col1, word=x0>>5; word<=(x1-1)>>5; word++) {
+    int32_t c0 = word*32 - box.origin.x > col0 ? word*32 - box.origin.x : col0, c1 = word*32 + 32 - box.origin.x < col1 ? word*32 + 32 - box.origin.x : col1;
+    int32_t first = box.size.h, last = -1;
+    uint32_t dither[4] = {0, 0, 0, 0}, cur = 0;
+    memset(on, 0, (box.size.h + 1) * sizeof(uint32_t));
+    memset(off, 0, (box.size.h + 1) * sizeof(uint32_t));
+    for(int32_t col=c0; col<c1; col++) {
+      if(span_bits[col] == 0) continue;
+      uint32_t bit = 1u << ((box.origin.x + col) & 31);
+      on[span_top[col]] |= bit; off[span_bottom[col] + 1] |= bit;
+      for(int32_t r=0; r<4; r++) if((span_bits[col] >> r) & 1) dither[r] |= bit;
+      if(span_top[col] < first) first = span_top[col];
+      if(span_bottom[col] > last) last = span_bottom[col];
+    }
+    if(last < 0) continue;  // Nothing in this word
+    uint32_t *row = dst + first * stride + word - word0;
+    for(int32_t y=first; y<=last; y++, row+=stride) {
+      cur = (cur | on[y]) & ~off[y];
+      *row |= cur & dither[y & 3];
+    }
+  }
+}
+
+static const RenderPathStruct render_paths[RENDER_PATHS] = {
+  [RENDER_TEXTURED]  = {wall_textured,  NULL,       true},
+  [RENDER_SHADED]    = {wall_shaded,    fill_spans, false},
+  [RENDER_WIREFRAME] = {wall_wireframe, fill_spans, false},
+};
+static const RenderPathStruct *render_path;  // This frame's
+
+//draw_columns(dst, stride, word0, box, col0, col1, dirx, diry)
+//  Traces the view columns from col0 up to col1 and draws their walls (and floor, if not drawing it by rows)
+//  dst, stride, word0 = where to draw, same as draw_floor_rows
+static void draw_columns(uint32_t *dst, int32_t stride, int32_t word0, GRect box, int32_t col0, int32_t col1, int32_t dirx, int32_t diry) {
+  int32_t colheight, perp, center = box.size.h/2; //colh, z;
+  uint32_t x, xbit, *coldst;
+
+  {PROFILE_SCOPE(PROFILE_RAYS); trace_columns(box, col0, col1, dirx, diry);}
+  PROFILE_SCOPE(PROFILE_WALLS);
+  for(int16_t col = col0; col < col1; col++) {  // Begin Drawing Loop
+    span_bits[col] = 0;
+    if(quality.col_step > 1 && !key_column(box, col)) {wall_half[col] = wall_half[col-1]; wall_depth[col] = wall_depth[col-1]; continue;}  // widen_columns copies it later
+    int32_t rayx = cols[col].dirx, rayy = cols[col].diry;  // Ray direction (for the floor)
+
+    x = col+box.origin.x;  // X screen coordinate
+    coldst = dst + (x >> 5) - word0;  // X memory address
+    xbit = (x & 31); // X bit shift level
+
+    int32_t hit = cols[col].hit;
+    const RayStruct *ray = &cols[col].ray;
+    if(options.dda)
+      perp = ray->dist;                                  // ray.dist is in ray lengths, which is already distance from the camera plane
+    else
+      perp = (ray->dist * column[col].cos) >> 16;        // un-fisheye
+
+    if(hit<0) {  // Out of range: nothing to see (black)
+      colheight = 0;
+    } else if(hit==0) {  //Shoot rays out of player's eyes.  pew pew.
+      // 0 means out of map bounds (hit the border), never hit anything.  Draw horizion dot
+      coldst[center * stride] |= (1u << xbit);
+      colheight = 1;
+    } else {
+      //1 means hit a block.  Draw the vertical line!
+
+      // Calculate amount of shade
+      //z = perp;  // z = distance
+      //z -= 64; if(z<0) z=0;   // Make everything 1 block (64px) closer (solid white without having to be nearly touching)
+      //z = sqrt_int(z,10) >> 1; // z was 0-RANGE(max dist visible), now z = 0 to 12: 0=close 10=distant.  Square Root makes it logarithmic
+      //z -= 2; if(z<0) z=0;    // Closer still (zWas=zNow: 0-64=0, 65-128=2, 129-192=3, 256=4, 320=6, 384=6, 448=7, 512=8, 576=9, 640=10)
+
+      // Draw the wall it hit (textured, shaded or just its edges)
+      colheight = render_path->wall(coldst, stride, col, x, ray, perp, box.size.h);
+    } // End If(Shoot_Ray)
+    wall_half[col] = colheight;
+    wall_depth[col] = hit < 0 ? INT32_MAX : perp;
+    if(options.floor_rows || quality.floor_step == 0 || !render_path->floor) continue;  // Floor gets drawn after the walls (or not at all)
+
+    int32_t mapx, mapy, texturex, texturey;
+    // Draw Floor/Ceiling
+    for(int32_t i=colheight; i<center; i+=quality.floor_step) {
+      if(floor_fog[i] == 0) continue;  // Too far away to see
+      //go over 64, go down i, how many until hit floor (aka h/2)
+      //(h/2) / i * 64
+      mapx = player.x + ((floor_dist[i] * rayx) >> 16);  // Ray length is 1/cos, so this un-fisheyes too
+      mapy = player.y + ((floor_dist[i] * rayy) >> 16);
+      texturex=mapx&63;
+      texturey=mapy&31;
+      if(floor_at(mapx >> 6, mapy >> 6)) {
+        STAT(floor_pixels, 2);
+        for(int32_t j=i; j<i+quality.floor_step && j<center; j++) {  // Same spot for the next floor_step rows
+          coldst[(center + j) * stride] |= (((materials[0].floor[texturex * 2] >> texturey) & (fog_row(floor_fog[j], center + j) >> xbit) & 1) << xbit);
+          coldst[(center - j) * stride] |= (((materials[0].ceiling[texturex * 2] >> texturey) & (fog_row(floor_fog[j], center - j) >> xbit) & 1) << xbit);
+        }
+      }
+    } // End Floor/Ceiling
+
+  } //End For (End Drawing Loop)
+  if(render_path->finish) render_path->finish(dst, stride, word0, box, col0, col1);
+}
+
+//----------------------------------//
+// Sprites                          //
+//----------------------------------//
+// Things standing in the view (agents), drawn over the walls: a 64x64 texel image, the size of a wall, always facing
+// the player.  draw_columns leaves every column's wall distance in wall_depth[], so a sprite only shows in columns
+// where it's nearer than the wall.  Sprites are only worked out any further if their square was seen: marked by a
+// view ray (ray.c), or else nearer than the wall in some column they cover (columns between two rays of a coherent
+// span don't mark squares).  The ones left are sorted by distance once, and drawn far to near as masked column spans.
+SpriteStruct sprites[MAX_SPRITES];
+int32_t sprite_count = 0;
+
+typedef struct VisibleSpriteStruct {
+  int32_t depth;              // Distance from the camera plane
+  int32_t left, size;         // View column of its left edge (can be off the view) and how many columns wide it is
+  const uint32_t *image;      // sprite_data
+} VisibleSpriteStruct;
+
+static VisibleSpriteStruct visible[MAX_SPRITES];  // Per frame
+static int32_t block_depth[MAX_VIEW_W/8 + 1];     // Per frame: farthest wall_depth in each 8 columns
+
+// Whether anything at depth is nearer than the walls in some view column from col0 up to col1
+static bool nearer_than_walls(int32_t depth, int32_t col0, int32_t col1) {
+  for(int32_t block = col0 >> 3; block <= (col1 - 1) >> 3; block++) {
+    if(depth >= block_depth[block]) continue;  // Behind all 8
+    for(int32_t col = col0 > block*8 ? col0 : block*8, end = col1 < block*8 + 8 ? col1 : block*8 + 8; col < end; col++)
+      if(depth < wall_depth[col]) return true;
+  }
+  return false;
+}
+
+// Where sprite s is in the view.  False if it's behind, off to the side, out of range, or behind the walls
+static bool project_sprite(const SpriteStruct *s, GRect box, int32_t dirx, int32_t diry, VisibleSpriteStruct *out) {
+  int32_t relx = s->x - player.x, rely = s->y - player.y;
+  int32_t depth = ((int64_t)relx * dirx + (int64_t)rely * diry) >> 16;  // Along the facing
+  if(depth < SPRITE_NEAR || depth >= options.range || (uint32_t)s->image >= SPRITE_COUNT) return false;
+  int32_t side = ((int64_t)rely * dirx - (int64_t)relx * diry) >> 16;   // Along the camera plane (right is +)
+  int64_t size = ((int64_t)box.size.w << 21) / ((int64_t)plane_half * depth);  // 64 pixels wide: column = w/2 + plane * w / (2 * plane_half)
+  int64_t left = (box.size.w >> 1) + ((int64_t)side * box.size.w << 15) / ((int64_t)plane_half * depth) - size/2;
+  if(size < 1 || left >= box.size.w || left + size <= 0) return false;
+  out->depth = depth; out->left = left; out->size = size;
+  out->image = sprite_data[s->image];
+  return seen_square(player.x, player.y, s->x >> 6, s->y >> 6) || nearer_than_walls(depth, left < 0 ? 0 : left, left + size < box.size.w ? left + size : box.size.w);
+}
+
+static int compare_depth(const void *a, const void *b) {return ((const VisibleSpriteStruct*)b)->depth - ((const VisibleSpriteStruct*)a)->depth;}  // Farthest first
+
+// Draws a sprite straight into the framebuffer: fb = view's top row.  Same texel stepping as draw_wall, but only the
+// rows between the column's first and last opaque texel are visited, and its mask picks which pixels get set or cleared.
+static void draw_sprite(uint32_t *fb, GRect box, const VisibleSpriteStruct *s) {
+  int32_t center = box.size.h/2, top, bottom, level = fog_level(s->depth);
+  int32_t vstep = ((uint32_t)s->depth << 16) / box.size.h, ustep = (TEXTURE_SIZE << 16) / s->size;
+  int32_t col0 = s->left < 0 ? 0 : s->left, col1 = s->left + s->size < box.size.w ? s->left + s->size : box.size.w;
+  wall_rows(s->depth, box.size.h, &top, &bottom);
+  for(int32_t col=col0, u=(col0 - s->left) * ustep; col<col1; col++, u+=ustep) {
+    if(s->depth >= wall_depth[col]) continue;  // Behind the wall
+    const uint32_t *texel = s->image + (u >> 16) * 4;  // Image's 2 words, then the mask's
+    uint64_t mask = texel[2] | (uint64_t)texel[3] << 32;
+    if(!mask) continue;
+    int32_t first = 0, last = 63;
+    while(!((mask >> first) & 1)) first++;
+    while(!((mask >> last) & 1)) last--;
+    int32_t y0 = center + ((first - 32) * box.size.h) / s->depth - 1, y1 = center + ((last + 1 - 32) * box.size.h) / s->depth + 1;
+    if(y0 < top) y0 = top;
+    if(y1 > bottom) y1 = bottom;
+    int32_t x = box.origin.x + col, v = (32 << 16) + (y0 - center) * vstep;
+    uint32_t fog = level < 16 ? fog_column(level, x) : 15, bit = 1u << (x & 31), *dst = fb + y0 * 5 + (x >> 5);
+    for(int32_t y=y0; y<=y1; y++, dst+=5, v+=vstep) {
+      int32_t word = (v >> 21) & 1, t = (v >> 16) & 31;
+      if(!((texel[2 + word] >> t) & 1)) continue;  // See-through
+      if((texel[word] >> t) & (fog >> (y & 3)) & 1) *dst |= bit; else *dst &= ~bit;
+    }
+  }
+}
+
+static void draw_sprites(uint32_t *fb, GRect box, int32_t dirx, int32_t diry) {
+  int32_t count = 0;
+  for(int32_t col=0; col<box.size.w; col++)
+    if((col & 7) == 0 || wall_depth[col] > block_depth[col >> 3]) block_depth[col >> 3] = wall_depth[col];
+  for(int32_t i=0; i<sprite_count; i++)
+    if(project_sprite(&sprites[i], box, dirx, diry, &visible[count])) count++;
+  if(count > 1) qsort(visible, count, sizeof(visible[0]), compare_depth);
+  for(int32_t i=0; i<count; i++) draw_sprite(fb, box, &visible[i]);
+  STAT(sprites_drawn, count);
+}
+
+// White border just outside a box (the view's, the minimap's)
+void draw_frame(GContext *ctx, GRect box) {
+  graphics_context_set_stroke_color(ctx, 1); graphics_draw_rect(ctx, GRect(box.origin.x-1, box.origin.y-1, box.size.w+2, box.size.h+2));  //White Rectangle Border
+}
+
+void draw_3D(GContext *ctx, GRect box) { //, int32_t zoom) {
+  int32_t dirx, diry;
+  uint32_t *fb = (uint32_t*)(((GBitmap*)ctx)->addr) + box.origin.y * 5;  // View's top row  (Y Address = Y screen coordinate * 5)
+
+  // Box around the view: draw_frame, drawn by the HUD (the view has its own layer on the watch)
+
+  // Draw background
+    // Umm... ok... A nice black background.  Done.  Next?
+    //graphics_context_set_fill_color(ctx, 1); graphics_fill_rect(ctx, GRect(box.x, box.origin.y, box.size.w, box.size.h/2), 0, GCornerNone); // White Sky  (Lightning?  Daytime?)
+
+  update_tables(box);
+  dirx = cos_lookup(player.facing);  // The only trig lookups all frame
+  diry = sin_lookup(player.facing);
+  for(int32_t i=0; i<box.size.h/2; i++) floor_fog[i] = fog_level(floor_dist[i]);
+  quality = qualities[options.quality < 0 ? 0 : options.quality > QUALITY_FULL ? QUALITY_FULL : options.quality];
+  key_from = (box.origin.x + quality.col_step - 1) & ~(quality.col_step - 1);
+  render_path = &render_paths[(uint32_t)options.render < RENDER_PATHS ? options.render : RENDER_TEXTURED];
+  bool floor_rows = options.floor_rows && quality.floor_step > 0 && render_path->floor;
+  start_trace(box);
+
+  if(!options.batched) {  // Draw straight into the framebuffer, on a black background
+    for(int32_t y=0; y<box.size.h; y++)  // The screen isn't cleared between frames: blank the view first
+      for(int32_t x=box.origin.x; x<box.origin.x+box.size.w; x=(x|31)+1) {
+        int32_t end = (x|31)+1 < box.origin.x+box.size.w ? (x|31)+1 : box.origin.x+box.size.w;
+        fb[y * 5 + (x >> 5)] &= ~(end - x == 32 ? 0xFFFFFFFF : ((1u << (end - x)) - 1) << (x & 31));
+      }
+    draw_columns(fb, 5, 0, box, 0, box.size.w, dirx, diry);
+    if(floor_rows) {PROFILE_SCOPE(PROFILE_FLOOR); draw_floor_rows(fb, 5, 0, box, 0, box.size.w, dirx, diry);}
+    widen_columns(fb, 5, 0, box, 0, box.size.w);
+    if(sprite_count) {PROFILE_SCOPE(PROFILE_SPRITES); draw_sprites(fb, box, dirx, diry);}
+    end_trace(box);
+    return;
+  }
+
+  // Batched: draw the up-to-32 columns sharing a framebuffer word into a blank staging column,
+  // then store each framebuffer word once per row.  Whatever was on screen before doesn't matter.
+  uint32_t stage[MAX_VIEW_H];
+  for(int32_t col0=0, col1; col0<box.size.w; col0=col1) {
+    int32_t x0 = box.origin.x + col0, word = x0 >> 5;
+    col1 = col0 + 32 - (x0 & 31); if(col1 > box.size.w) col1 = box.size.w;
+    uint32_t mask = (col1 - col0 == 32) ? 0xFFFFFFFF : ((1u << (col1 - col0)) - 1) << (x0 & 31);  // View's pixels in this word
+
+    memset(stage, 0, box.size.h * sizeof(uint32_t));
+    draw_columns(stage, 1, word, box, col0, col1, dirx, diry);
+    if(floor_rows) {PROFILE_SCOPE(PROFILE_FLOOR); draw_floor_rows(stage, 1, word, box, col0, col1, dirx, diry);}
+    widen_columns(stage, 1, word, box, col0, col1);
+
+    uint32_t *out = fb + word;
+    if(mask == 0xFFFFFFFF)
+      for(int32_t y=0; y<box.size.h; y++, out+=5) *out = stage[y];
+    else  // Word is shared with whatever is beside the view
+      for(int32_t y=0; y<box.size.h; y++, out+=5) *out = (*out & ~mask) | stage[y];
+  }
+  if(sprite_count) {PROFILE_SCOPE(PROFILE_SPRITES); draw_sprites(fb, box, dirx, diry);}  // Over the finished walls
+  end_trace(box);
+}
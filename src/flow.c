@@ -0,0 +1,128 @@
+#include "main.h"
+
+// ------------------------------------------------------------------------ //
+//  Flow Field
+// ------------------------------------------------------------------------ //
+// Agents chase the player by walking downhill on one field they all share: dist[] is how many steps (4 directions,
+// breadth first) each square is from the player's square.  It's laid out like the map with its border, row by row
+// (map_w + 2 squares a row, not map_solid's power of two), so neighbours are +-1 and +-row.  Walls are marked in it
+// (FLOW_WALL, the border too), so the border stops the search without bounds checks.
+// It's worked out again, breadth first from the player's square, only when the player steps into another square or
+// the map changes (map_changes), and kept as it is between.  Repairing it in place instead doesn't pay: when the
+// player moves one square, nearly every distance in an open map changes, so a repair visits the whole field anyway
+// and measured slower than starting over.
+// Maps in RAM only: a streamed world has no field, and agents stand still.
+// Memory is 2 bytes a square for dist, plus 2 for the queue (an open square goes in once): about 1.8KB for the
+// 20x20 map, 17KB at 64x64 and 66KB at MAP_MAX.
+#define FLOW_WALL 0xFFFF            // dist of a solid square
+#define FLOW_LOST 0xFFFE            // dist of an open square with no way to the target
+static uint16_t *dist = NULL;       // Steps to the target, per square (border included)
+static uint16_t *queue = NULL;      // Squares to visit (map_w * map_h long)
+static int32_t cells = 0, row = 0;  // Length of dist, and how far apart rows are (map_w + 2)
+static int32_t target = -1;         // Player's square
+static bool fresh = false;          // Field is of the current map (else flow_update works it out again)
+static uint32_t flow_changes;       // map_changes it's up to date with
+
+AgentStruct agents[MAX_AGENTS];
+int32_t agent_count = 0;
+uint32_t agent_moves = 0;
+
+static inline int32_t square(int32_t x, int32_t y) {return (y + 1) * row + x + 1;}  // dist index of square x,y
+
+static void free_field(void) {
+  free(dist); free(queue);
+  dist = queue = NULL;
+  cells = 0; fresh = false;
+}
+
+// Works the field out for the current map, target square x,y
+static bool rebuild(int32_t x, int32_t y) {
+  int32_t size = (map_w + 2) * (map_h + 2), head = 0, tail = 0;
+  if(size != cells || map_w + 2 != row) {
+    free_field();
+    if(size > 65536) return false;  // Squares are uint16_t (a MAP_MAX map is about a quarter of that)
+    dist = malloc(size * sizeof(uint16_t)); queue = malloc(map_w * map_h * sizeof(uint16_t));
+    if(!dist || !queue) {free_field(); return false;}
+    cells = size;
+    row = map_w + 2;
+  }
+  memset(dist, 0xFF, cells * sizeof(uint16_t));  // FLOW_WALL (the border stays that way)
+  for(int32_t sy=0; sy<map_h; sy++)
+    for(int32_t sx=0; sx<map_w; sx++)
+      if(!solid(sx, sy)) dist[square(sx, sy)] = FLOW_LOST;
+  target = square(x, y);
+  fresh = true;
+  flow_changes = map_changes;
+  if(dist[target] == FLOW_WALL) return true;  // Standing in a wall: there's no way anywhere
+  dist[target] = 0; queue[tail++] = target;
+  while(head < tail) {
+    int32_t i = queue[head++];
+    uint16_t d = dist[i] + 1;
+    STAT(flow_squares, 1);
+    if(dist[i-1]   == FLOW_LOST) {dist[i-1]   = d; queue[tail++] = i-1;}
+    if(dist[i+1]   == FLOW_LOST) {dist[i+1]   = d; queue[tail++] = i+1;}
+    if(dist[i-row] == FLOW_LOST) {dist[i-row] = d; queue[tail++] = i-row;}
+    if(dist[i+row] == FLOW_LOST) {dist[i+row] = d; queue[tail++] = i+row;}
+  }
+  return true;
+}
+
+void flow_reset(void) {fresh = false;}
+
+bool flow_update(int32_t x, int32_t y) {
+  if(map_streamed || !map_solid || x < 0 || y < 0 || x >= map_w || y >= map_h) return false;
+  if(fresh && dist && row == map_w + 2 && cells == (map_w + 2) * (map_h + 2) && flow_changes == map_changes && square(x, y) == target)
+    return true;  // Same square, same map: still up to date
+  return rebuild(x, y);
+}
+
+uint32_t flow_dist(int32_t x, int32_t y) {
+  if(!fresh || !dist || x < 0 || y < 0 || x >= map_w || y >= map_h) return FLOW_FAR;
+  uint32_t d = dist[square(x, y)];
+  return d >= FLOW_LOST ? FLOW_FAR : d;
+}
+
+// ------------------------------------------------------------------------ //
+//  Agents
+// ------------------------------------------------------------------------ //
+bool add_agent(int32_t x, int32_t y) {
+  if(agent_count >= MAX_AGENTS) return false;
+  agents[agent_count++] = (AgentStruct){.x = x, .y = y};
+  agent_moves++;
+  return true;
+}
+
+void clear_agents(void) {
+  agent_count = 0;
+  agent_moves++;
+}
+
+static inline int32_t step_towards(int32_t from, int32_t to) {
+  return from + (to - from > AGENT_SPEED ? AGENT_SPEED : to - from < -AGENT_SPEED ? -AGENT_SPEED : to - from);
+}
+
+// One simulation tick: each agent heads for the middle of a neighbouring square one step closer to the player,
+// or for the player once it's in the same square (stopping AGENT_NEAR short).  Moving from inside a square
+// straight to the middle of the next one never crosses any other square, so agents need no collisions.
+// Call flow_update first.  Agents cut off from the player (or with no field) stand still.
+void move_agents(void) {
+  static const int8_t dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};  // Right, down, left, up
+  if(!fresh || !dist) return;
+  for(int32_t a=0; a<agent_count; a++) {
+    AgentStruct *agent = &agents[a];
+    int32_t x = agent->x >> 6, y = agent->y >> 6, i = square(x, y), tox, toy;
+    uint32_t d = dist[i];
+    if(d >= FLOW_LOST) continue;
+    if(d == 0) {
+      if(abs32(player.x - agent->x) < AGENT_NEAR && abs32(player.y - agent->y) < AGENT_NEAR) continue;
+      tox = player.x; toy = player.y;
+    } else {
+      int32_t k = 0;
+      while(k < 3 && dist[i + dx[k] + dy[k] * row] + 1u != d) k++;  // Downhill (there's always one)
+      tox = ((x + dx[k]) << 6) + 32; toy = ((y + dy[k]) << 6) + 32;
+    }
+    agent->x = step_towards(agent->x, tox);
+    agent->y = step_towards(agent->y, toy);
+    agent_moves++;
+  }
+}
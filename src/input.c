@@ -0,0 +1,44 @@
+#include "main.h"
+
+// ------------------------------------------------------------------------ //
+//  Tilt Input
+// ------------------------------------------------------------------------ //
+// The accelerometer hands its samples over ACCEL_BATCH at a time (accel_data_service), instead of main_loop waking
+// up every tick to peek at it.  Each sample moves the filtered tilt 1/2^ACCEL_SMOOTH of the way towards it: a
+// low-pass in fixed point (x16, so small steps aren't rounded away) that shakes off most of the sensor noise.
+// Samples taken while the watch vibrated are skipped.  tilt_read then takes ACCEL_DEAD_ZONE off, so the player
+// speeds up smoothly from standing still instead of jumping to the dead zone's speed, and noise on a watch lying
+// flat stays at 0 (which is how main_loop knows nothing's happening).
+// Pure arithmetic on the samples it's given, so the host benchmark can feed it made-up ones.
+
+void tilt_reset(TiltStruct *t) {
+  *t = (TiltStruct){.x = 0, .y = 0};
+}
+
+// One batch of samples, oldest first
+void tilt_filter(TiltStruct *t, const AccelData *data, uint32_t count) {
+  for(uint32_t i=0; i<count; i++) {
+    if(data[i].did_vibrate) continue;  // The motor shakes the readings
+    t->x += ((data[i].x << 4) - t->x) >> ACCEL_SMOOTH;
+    t->y += ((data[i].y << 4) - t->y) >> ACCEL_SMOOTH;
+    t->samples++;
+  }
+  t->batches++;
+}
+
+static inline int32_t dead_zone(int32_t a) {
+  a >>= 4;  // x16 to milli-g
+  return a > ACCEL_DEAD_ZONE ? a - ACCEL_DEAD_ZONE : a < -ACCEL_DEAD_ZONE ? a + ACCEL_DEAD_ZONE : 0;
+}
+
+// Filtered tilt in milli-g, less the dead zone (0 inside it)
+void tilt_read(const TiltStruct *t, int32_t *x, int32_t *y) {
+  *x = dead_zone(t->x);
+  *y = dead_zone(t->y);
+}
+
+bool tilt_still(const TiltStruct *t) {
+  int32_t x, y;
+  tilt_read(t, &x, &y);
+  return x == 0 && y == 0;
+}
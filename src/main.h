@@ -0,0 +1,365 @@
+#pragma once
+#include "pebble.h"
+#include "textures.auto.h"       // Generated by tools/texgen.py from the PNG resources
+
+#define mapsize 20             // Map is 20x20 squares, or whatever number is here (up to MAP_MAX)
+
+#define RANGE 64 * 30          // Distance player can see - Pixels-per-square * #-of-squares -- max 1024 squares due to (64*1024)^2 = 32bit max
+#define NIGHT_RANGE 64 * 3     // Night time: can only see 3 away
+#define NIGHT_FOG 64 * 1       //   and it starts getting dark 1 away
+#define IDCLIP false           // Walk thru walls
+#define view_border true       // Draw border around viewing window
+
+// Render paths (options.render): how the view gets drawn.  main.c switches them at runtime (double-click SELECT, low battery)
+enum {
+  RENDER_TEXTURED,            // Textured walls, floor and ceiling
+  RENDER_SHADED,              // Flat walls, dithered by distance and face, no floor or ceiling
+  RENDER_WIREFRAME,           // Only the edges of the walls
+  RENDER_PATHS
+};
+
+typedef struct PlayerStruct {
+  int32_t x;                  // Player's X Position x64
+  int32_t y;                  // Player's Y Position x64
+  int32_t facing;             // Player Direction Facing (from 0 - TRIG_MAX_ANGLE)
+} PlayerStruct;
+
+typedef struct RayStruct {
+   int32_t x;                 // x coordinate on map the ray hit
+   int32_t y;                 // y coordinate on map the ray hit
+  uint32_t dist;              // length of the ray / distance ray traveled
+    int8_t hit;               // block type the ray hit
+   int32_t offset;            // horizontal spot on texture the ray hit [0-63]
+   uint8_t face;              // face of the block it hit (00=west, 01=north, 10=east, 11=south)  bit0: hit moving in y, bit1: hit moving backwards
+   uint8_t bounces;           // how many mirrors the ray bounced off on the way
+} RayStruct;
+
+enum {RAY_SHOT, RAY_SIGHT};   // RayQueryStruct.kind
+typedef struct RayQueryStruct {
+  uint8_t kind;               // RAY_SHOT: what a ray from x,y at angle hits (out to options.range, off mirrors like the view)
+                              // RAY_SIGHT: whether anything solid is between x,y and tox,toy (mirrors too)
+  int32_t x, y;               // From (pixels)
+  int32_t angle;              // RAY_SHOT: direction (Pebble angle)
+  int32_t tox, toy;           // RAY_SIGHT: to (pixels)
+  int32_t result;             // RAY_SHOT: same as shoot_ray (1 = hit a block).  RAY_SIGHT: 1 = clear, 0 = something's in the way
+  RayStruct ray;              // What it hit (RAY_SIGHT: what's in the way, and the corner of its square)
+} RayQueryStruct;
+
+typedef struct MaterialStruct {
+  const uint32_t *wall;       // Texture on the block's sides (TEXTURE_WORDS words, column-major), NULL if empty
+  const uint32_t *floor;      // Textures on the floor and ceiling (empty squares)
+  const uint32_t *ceiling;
+  bool mirror;                // Rays bounce off it instead of stopping
+} MaterialStruct;
+
+typedef struct OptionsStruct {
+  bool dda;                   // shoot_ray uses the incremental DDA traversal (no divisions per grid step)
+  bool floor_rows;            // Cast floor/ceiling a row at a time after the walls, instead of down each column
+  bool batched;               // Build 32 columns at a time in a staging buffer, then store each framebuffer word once
+  bool coherent;              // Cast rays a span apart and work out the columns between straight from the wall face when both ends hit the same one
+  bool reuse;                 // When the player only turned, work out columns from last frame's rays where it can
+  int32_t range;              // Farthest anything is seen (pixels, up to 1024 squares): rays give up past it, and it's black
+  int32_t fog;                // Walls and floor past this fade out (dithered) to black at range.  fog >= range: no fog
+  bool cached_map;            // draw_map copies from a cached image of the map instead of working out every pixel
+  int32_t render;             // Render path (RENDER_TEXTURED, ...)
+  int32_t quality;            // How much detail to draw, 0 to QUALITY_FULL (see draw.c): main.c lowers it when frames run over budget
+  bool seen_cells;            // draw_3D marks the squares its rays go through, so sprites on them skip the wall check
+} OptionsStruct;
+
+// ------------------------------------------------------------------------ //
+//  Math Functions
+// ------------------------------------------------------------------------ //
+static inline int32_t sqrt_int(int32_t a, int8_t root_depth) {int32_t b=a; for(int8_t i=0; i<root_depth; i++) b=(b+(a/b))/2; return b;} // Square Root
+static inline int32_t  abs_int(int32_t a){return (a<0 ? 0 - a : a);} // Absolute Value
+
+#define root_depth 10          // How many iterations square root function performs
+static inline int32_t  sqrt32(int32_t a) {int32_t b=a; for(int8_t i=0; i<root_depth; i++) b=(b+(a/b))/2; return b;} // Square Root
+
+static inline int32_t abs32(int32_t x) {return (x^(x>>31)) - (x>>31);}
+static inline int16_t abs16(int16_t x) {return (x^(x>>15)) - (x>>15);}
+static inline int8_t  abs8 (int8_t  x) {return (x^(x>> 7)) - (x>> 7);}
+
+static inline uint32_t clock_ms(void) {time_t sec; uint16_t ms; time_ms(&sec, &ms); return (uint32_t)sec * 1000 + ms;}  // Wall clock in ms (wraps: only use differences)
+
+static inline int8_t  sign8 (int8_t  x){return (x > 0) - (x < 0);}
+static inline int16_t sign16(int16_t x){return (x > 0) - (x < 0);}
+static inline int32_t sign32(int32_t x){return (x > 0) - (x < 0);}
+
+// ------------------------------------------------------------------------ //
+//  Benchmark Counters
+// ------------------------------------------------------------------------ //
+// Only compiled in by the host benchmark build (host/Makefile defines ENGINE_STATS), or with the profiler.
+// On the watch STAT() expands to nothing, so the counters cost nothing there.
+#if defined(ENGINE_STATS) || defined(ENGINE_PROFILE)
+typedef struct StatsStruct {
+  uint32_t rays;              // shoot_ray calls
+  uint32_t ray_steps;         // grid lines crossed by all rays
+  uint32_t wall_pixels;       // wall texels written
+  uint32_t floor_pixels;      // floor + ceiling texels written
+  uint32_t chunk_lookups;     // streamed world: squares looked up
+  uint32_t chunk_stalls;      // streamed world: lookups that had to wait for a chunk to load
+  uint32_t chunk_prefetches;  // streamed world: chunks loaded ahead of time
+  uint32_t flow_squares;      // flow field: squares visited working it out
+  uint32_t sprites_drawn;     // sprites left after culling
+} StatsStruct;
+extern StatsStruct stats;
+#define STAT(counter, n) (stats.counter += (n))
+#else
+#define STAT(counter, n)
+#endif
+
+// ------------------------------------------------------------------------ //
+//  profile.c
+// ------------------------------------------------------------------------ //
+// Per-stage frame timings, only compiled in with ENGINE_PROFILE (the host build, or add it to the wscript).
+// Without it PROFILE_SCOPE expands to nothing.  Times are in us, but the watch has no clock finer than ms
+// (PROFILE_CLOCK_MS): a stage's time in one frame is a whole number of ms, often 0, so there only the average
+// over the ring means anything.  The host build has a us clock (PROFILE_CLOCK_US in its pebble.h).
+enum {
+  PROFILE_RAYS,               // Casting view rays (trace_columns)
+  PROFILE_WALLS,              // Drawing wall columns (and floor, if it's drawn down the columns)
+  PROFILE_FLOOR,              // Floor/ceiling rows
+  PROFILE_SPRITES,            // Culling, sorting and drawing sprites
+  PROFILE_MAP,                // draw_map
+  PROFILE_TEXT,               // Text box
+  PROFILE_FRAME,              // The whole frame
+  PROFILE_STAGES,
+  PROFILE_RAY_COUNT = PROFILE_STAGES,  // Not a time: rays cast
+  PROFILE_VALUES
+};
+#define PROFILE_FRAMES 32      // Frames kept in the ring
+
+#ifdef ENGINE_PROFILE
+#ifndef PROFILE_CLOCK_US
+#define PROFILE_CLOCK_US() (clock_ms() * 1000)
+#define PROFILE_CLOCK_MS       // Only whole ms: min/p95 of a stage would read 0 or 1000, so only averages are shown
+#endif
+typedef struct ProfileScopeStruct {
+  uint8_t stage;
+  uint32_t start;
+} ProfileScopeStruct;
+
+typedef struct ProfileSummaryStruct {
+  uint32_t min, avg, p95;
+} ProfileSummaryStruct;
+
+extern const char *const profile_names[PROFILE_VALUES];
+extern uint32_t profile_now[PROFILE_STAGES];
+bool profile_end_frame(void);
+ProfileSummaryStruct profile_summary(int32_t value);
+void profile_reset(void);
+static inline void profile_scope_end(ProfileScopeStruct *scope) {profile_now[scope->stage] += PROFILE_CLOCK_US() - scope->start;}
+#define PROFILE_NAME(line) profile_scope_##line
+#define PROFILE_SCOPE_AT(stage, line) __attribute__((cleanup(profile_scope_end))) ProfileScopeStruct PROFILE_NAME(line) = {(stage), PROFILE_CLOCK_US()}
+#define PROFILE_SCOPE(stage) PROFILE_SCOPE_AT(stage, __LINE__)  // Times the rest of the block
+#else
+#define PROFILE_SCOPE(stage)
+#endif
+
+// ------------------------------------------------------------------------ //
+//  world.c
+// ------------------------------------------------------------------------ //
+// Streamed worlds: too big for RAM, so they stay in a raw resource cut into CHUNK_SIZE x CHUNK_SIZE chunks,
+// and the chunks being looked at are loaded into a small LRU cache.  While a world is open, map_streamed is set
+// and every map lookup (solid, getcell, getmap, floor_at) goes through chunk_at instead of the map planes.
+#define CHUNK_SHIFT 4
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)  // Squares per chunk side
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define CHUNK_CACHE 16                 // Chunks kept in RAM (about 2.6KB)
+#define NO_CHUNK INT16_MIN             // ChunkStruct.cx of an empty cache slot
+
+typedef struct ChunkStruct {
+  int16_t cx, cy;                      // Which chunk this is (in chunks)
+  uint32_t used;                       // When it was last switched to (for LRU)
+  uint16_t solid[CHUNK_SIZE];          // A row per uint16: bit x set = square x is solid
+  uint8_t attr[CHUNK_SIZE * CHUNK_SIZE / 2];  // 4 bits per square, same as map_attr
+} ChunkStruct;
+
+extern bool map_streamed;
+extern ChunkStruct *last_chunk;
+ChunkStruct *find_chunk(int32_t cx, int32_t cy);
+bool open_world(uint32_t resource_id);
+void close_world();
+void prefetch_world(int32_t x, int32_t y, int32_t facing);
+static inline ChunkStruct *chunk_at(int32_t x, int32_t y) {  // Chunk holding square x,y, NULL if off the world.  Nearly always the same one as last time
+  STAT(chunk_lookups, 1);
+  return (last_chunk->cx == (x >> CHUNK_SHIFT) && last_chunk->cy == (y >> CHUNK_SHIFT)) ? last_chunk : find_chunk(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+}
+static inline uint8_t chunk_attr(const ChunkStruct *c, int32_t x, int32_t y) {uint32_t i = ((y & CHUNK_MASK) << CHUNK_SHIFT) + (x & CHUNK_MASK); return (c->attr[i >> 1] >> ((i & 1) << 2)) & 15;}
+
+// ------------------------------------------------------------------------ //
+//  map.c
+// ------------------------------------------------------------------------ //
+extern PlayerStruct player;
+// The map is kept in two planes, sized by create_map (up to MAP_MAX squares a side):
+//   map_solid: 1 bit per square, set where rays and the player stop.  This is all the ray and walk loops read.
+//              It has a solid 1-square border all the way around and rows 1<<map_shift bits apart (a power of two),
+//              so a lookup is a shift and an index with no bounds checks.  Rays and the player always stop at
+//              the border, so they never look further out than 1 square off the map.
+//   map_attr:  4 bits per square (no border), rows 1<<attr_shift squares apart: block type, and a "special" bit
+//              (maze dead ends, something here).  Only read once a ray hits something, and for floor spots.
+// getcell/getmap still give one int8 per square: 0=empty, >0=block type, -1=special, VOID_BLOCK=off the map.
+// (Or a streamed world: see world.c.)
+#define MAP_MAX 128            // Biggest map create_map makes: 128x128 is 4KB solid + 8KB attributes
+#define BLOCK_BITS 7           // map_attr bits 0-2: block type
+#define SPECIAL_BIT 8          // map_attr bit 3: special square (reads back as -1)
+#define VOID_BLOCK 7           // Off the map (never stored): solid, never drawn, rays stop on it like running off the map
+extern int32_t map_w, map_h;   // Map size in squares
+extern int32_t map_shift, attr_shift;
+extern uint32_t *map_solid;
+extern uint8_t *map_attr;
+extern uint32_t map_changes;   // Goes up whenever the map changes (anything drawn from it is out of date)
+#define MAP_CHANGE_LOG 16      // How many of the latest changes map_change remembers the square of
+bool map_change(uint32_t change, int32_t *x, int32_t *y);
+#define MATERIAL_COUNT 5       // Block types 0 to MATERIAL_COUNT-1 have an entry in materials[]
+extern const MaterialStruct materials[MATERIAL_COUNT];
+static inline const MaterialStruct *material(int8_t cell) {return &materials[(uint8_t)cell < MATERIAL_COUNT ? cell : 1];} // Block types without an entry look like normal blocks
+bool create_map(int32_t w, int32_t h);
+void destroy_map();
+void GenerateRandomMap();
+void GenerateMazeMap(int32_t startx, int32_t starty, uint32_t seed);  // Same seed, same maze
+void clear_map(int8_t value);
+static inline uint32_t solid_bit(int32_t x, int32_t y) {return ((y + 1) << map_shift) + x + 1;}  // map_solid bit of square x,y
+static inline bool solid(int32_t x, int32_t y) {  // Square x,y (-1 to map_w/map_h: the border is solid)
+  if(map_streamed) {ChunkStruct *c = chunk_at(x, y); return !c || ((c->solid[y & CHUNK_MASK] >> (x & CHUNK_MASK)) & 1);}
+  uint32_t i = solid_bit(x, y); return (map_solid[i >> 5] >> (i & 31)) & 1;
+}
+static inline int8_t getcell(int32_t x, int32_t y) {  // Square x,y (on the map)
+  uint8_t a;
+  if(map_streamed) a = chunk_attr(chunk_at(x, y), x, y);
+  else {uint32_t i = (y << attr_shift) + x; a = map_attr[i >> 1] >> ((i & 1) << 2);}
+  return (a & SPECIAL_BIT) ? -1 : (a & BLOCK_BITS);
+}
+static inline int8_t getcell_far(int32_t x, int32_t y) {return ((uint32_t)x < (uint32_t)map_w && (uint32_t)y < (uint32_t)map_h) ? getcell(x, y) : VOID_BLOCK;} // Any square, VOID_BLOCK if off the map
+static inline int8_t getmap(int32_t x, int32_t y) {return getcell_far(x >> 6, y >> 6);}  // Same, in pixels
+static inline bool floor_at(int32_t x, int32_t y) {  // Any square: has a floor (same as getcell_far >= 0 && != VOID_BLOCK)
+  if((uint32_t)x >= (uint32_t)map_w || (uint32_t)y >= (uint32_t)map_h) return false;
+  if(map_streamed) return !(chunk_attr(chunk_at(x, y), x, y) & SPECIAL_BIT);
+  uint32_t i = (y << attr_shift) + x; return !((map_attr[i >> 1] >> ((i & 1) << 2)) & SPECIAL_BIT);
+}
+void setcell(int32_t x, int32_t y, int8_t value);  // Square x,y (on the map)
+void setmap(int32_t x, int32_t y, int8_t value);   // Pixels, anywhere (off the map does nothing)
+void walk(int32_t direction, int32_t distance);
+
+// ------------------------------------------------------------------------ //
+//  ray.c
+// ------------------------------------------------------------------------ //
+extern RayStruct ray;
+static inline int32_t ray_budget(int32_t range) {return 2 * (range >> 6) + 4;}  // Most grid lines a ray crosses before giving up (enough to reach range at any angle, for a ray vector up to sqrt2 long)
+int32_t shoot_ray(int32_t x, int32_t y, int32_t angle);
+int32_t shoot_ray_dda(int32_t x, int32_t y, int32_t cos, int32_t sin);
+bool begin_seen(int32_t x, int32_t y);   // draw_3D: mark the squares rays from x,y go through (until end_seen).  False if last frame's marks are gone
+void end_seen(void);
+bool seen_square(int32_t x, int32_t y, int32_t sx, int32_t sy);  // A ray from x,y (pixels) went through square sx,sy (false if it isn't known)
+int32_t query_ray(RayQueryStruct *q);    // Re-entrant.  Returns q->result
+void query_rays(RayQueryStruct *q, int32_t count);
+
+// ------------------------------------------------------------------------ //
+//  schedule.c
+// ------------------------------------------------------------------------ //
+#define SIM_TICK_MS 50         // Simulation tick: input, walking and collisions run 20 times a second
+#define SIM_MAX_TICKS 5        // Most ticks run to catch up in one go (longer stalls lose the time instead of snowballing)
+#define FRAME_BUDGET_MS 40     // Target time to draw a frame (leaves the rest of a tick for everything else)
+#define QUALITY_LEVELS 4       // Render quality levels (options.quality), 0 = cheapest
+#define QUALITY_FULL (QUALITY_LEVELS - 1)
+#define QUALITY_UP_PCT 60      // Raise the quality again once frames take under 60% of the budget
+#define QUALITY_HOLD 16        // Frames to wait after changing quality before changing it again (the average has to catch up)
+#define QUALITY_HOLD_MAX 256   // Longest wait before trying a level up that keeps going straight back down
+
+typedef struct SchedulerStruct {
+  uint32_t last;              // Clock at the last scheduler_update (ms)
+  uint32_t behind;            // Simulation time due but not run yet (ms, under SIM_TICK_MS after an update)
+  uint32_t ticks;             // Simulation ticks run
+  uint32_t lost_ms;           // Simulation time let go after long stalls
+  uint32_t slept_ms;          // Time idled through (scheduler_resume), not simulated
+  uint32_t frames;            // Frames drawn
+  uint32_t frames_dropped;    // Ticks that didn't get a frame of their own because drawing fell behind
+  uint32_t frames_over;       // Frames that took longer than FRAME_BUDGET_MS
+  uint32_t frame_ms;          // How long the last frame took to draw
+  uint32_t frame_avg;         // Recent average frame time (ms x16)
+  uint32_t fps;               // Frames drawn per second, over the last second or so
+  uint32_t fps_start, fps_frames;
+  int32_t quality;            // Render quality that keeps frames within FRAME_BUDGET_MS (for options.quality)
+  uint32_t quality_hold;      // Frames until quality can change again
+  uint32_t quality_backoff;   // Frames to wait after the next level down
+  bool quality_raised;        // Last change was a level up (and it hasn't settled yet)
+} SchedulerStruct;
+
+void scheduler_start(SchedulerStruct *s, uint32_t now);
+uint32_t scheduler_update(SchedulerStruct *s, uint32_t now);
+void scheduler_resume(SchedulerStruct *s, uint32_t now);
+void scheduler_frame(SchedulerStruct *s, uint32_t start, uint32_t end);
+uint32_t scheduler_wait(const SchedulerStruct *s, uint32_t now);
+
+// ------------------------------------------------------------------------ //
+//  input.c
+// ------------------------------------------------------------------------ //
+// Tilt from the accelerometer, sampled in batches and filtered (see input.c).  Each batch waits up to
+// ACCEL_BATCH samples, and the filter takes about 2^ACCEL_SMOOTH samples to get half way to a new tilt:
+// together they stay within ACCEL_LATENCY_MS of a tilt (the host benchmark checks), with fewer wakeups than ticks.
+#define ACCEL_RATE_HZ 50       // Samples a second (an AccelSamplingRate: those are in Hz)
+#define ACCEL_BATCH 4          // Samples per accel_data_service call: 80ms apart, 12.5 wakeups a second (main_loop ticks 20)
+#define ACCEL_SMOOTH 2         // Low-pass: each sample moves the filtered tilt 1/4 of the way to it
+#define ACCEL_DEAD_ZONE 48     // Tilt (x or y, milli-g) smaller than this is the watch lying still, not input
+#define ACCEL_LATENCY_MS 150   // Target: from tilting the watch to main_loop seeing half of it, on average
+
+typedef struct TiltStruct {
+  int32_t x, y;               // Filtered tilt (milli-g x 16)
+  uint32_t samples;           // Samples filtered
+  uint32_t batches;           // Batches taken in (wakeups)
+} TiltStruct;
+
+void tilt_reset(TiltStruct *t);
+void tilt_filter(TiltStruct *t, const AccelData *data, uint32_t count);  // A batch from accel_data_service
+void tilt_read(const TiltStruct *t, int32_t *x, int32_t *y);             // Filtered tilt less the dead zone (milli-g)
+bool tilt_still(const TiltStruct *t);                                     // Inside the dead zone both ways
+
+// ------------------------------------------------------------------------ //
+//  draw.c
+// ------------------------------------------------------------------------ //
+extern OptionsStruct options;
+extern GRect view;
+extern int32_t fov;
+void fill_window(GContext *ctx, uint8_t *data);
+void draw_frame(GContext *ctx, GRect box);
+void draw_3D(GContext *ctx, GRect box);
+
+#define MAX_SPRITES 128
+#define SPRITE_NEAR 8          // Sprites closer to the camera plane than this (pixels) aren't drawn
+typedef struct SpriteStruct {
+  int32_t x;                  // Position x64, like the player's (the middle of the image)
+  int32_t y;
+  uint8_t image;              // SPRITE_AGENT, ... (sprite_data, from tools/texgen.py)
+} SpriteStruct;
+extern SpriteStruct sprites[MAX_SPRITES];
+extern int32_t sprite_count;   // draw_3D draws the first sprite_count
+
+// ------------------------------------------------------------------------ //
+//  minimap.c
+// ------------------------------------------------------------------------ //
+void draw_map(GContext *ctx, GRect box, int32_t zoom);  // zoom = pixels per square.  Clipped to the screen
+static inline uint8_t map_cursor_color(void) {return (time_ms(NULL, NULL) % 250) > 125 ? 0 : 1;}  // Minimap cursor flashes 4 times a second
+
+// ------------------------------------------------------------------------ //
+//  flow.c
+// ------------------------------------------------------------------------ //
+// Agents (enemies) chasing the player, all following one distance field to the player's square.
+#define FLOW_FAR 0xFFFF        // flow_dist of a wall, or a square with no way to the player
+#define MAX_AGENTS 128
+#define AGENT_SPEED 6          // Pixels an agent moves per simulation tick, each way (the player walks up to about 30)
+#define AGENT_NEAR 24          // How close agents come to the player
+
+typedef struct AgentStruct {
+  int32_t x;                  // Position x64, like the player's
+  int32_t y;
+} AgentStruct;
+
+extern AgentStruct agents[MAX_AGENTS];
+extern int32_t agent_count;
+extern uint32_t agent_moves;   // Goes up whenever an agent moves (or one's added or removed)
+bool flow_update(int32_t x, int32_t y);   // Field to square x,y (the player's), up to date with the map.  False if there isn't one (streamed world)
+void flow_reset(void);                    // Next flow_update works it out from scratch
+uint32_t flow_dist(int32_t x, int32_t y); // Steps from square x,y to the player's, FLOW_FAR if there's no way
+bool add_agent(int32_t x, int32_t y);     // Pixels.  False if there are MAX_AGENTS already
+void clear_agents(void);
+void move_agents(void);                   // One simulation tick, after flow_update
@@ -0,0 +1,157 @@
+#include "main.h"
+
+PlayerStruct player;
+int32_t map_w = 0, map_h = 0;    // Map size in squares
+int32_t map_shift, attr_shift;   // map_solid rows are 1<<map_shift bits apart, map_attr rows 1<<attr_shift squares apart
+uint32_t *map_solid = NULL;      // 1 bit per square (+ border): square x,y is bit solid_bit(x, y)
+uint8_t *map_attr = NULL;        // 4 bits per square: square x,y is nibble (y << attr_shift) + x, low nibble first
+uint32_t map_changes = 0;        // setcell and destroy_map (so create_map and open_world too) count up
+static struct {int16_t x, y;} change_log[MAP_CHANGE_LOG];  // Square each of the latest changes was to (-1: the whole map)
+
+// Block types: what map values look like and how rays treat them.  Adding a block type is adding a line here.
+// Negative values (maze "special" squares, and off the map) aren't blocks and have no entry.
+const MaterialStruct materials[MATERIAL_COUNT] = {
+  [0] = {.floor = texture_data[TEXTURE_FLOOR_TILE], .ceiling = texture_data[TEXTURE_CEILING_LIGHTS]},  // Empty
+  [1] = {.wall = texture_data[TEXTURE_STONE]},                     // Normal block
+  [2] = {.wall = texture_data[TEXTURE_WALL_FIFTY]},
+  [3] = {.wall = texture_data[TEXTURE_WALL_CIRCLE]},               // Circle block
+  [4] = {.wall = texture_data[TEXTURE_WALL_BRICK], .mirror = true}, // Mirror (rays never stop on it, so the wall never shows)
+};
+
+// ------------------------------------------------------------------------ //
+//  Map Functions
+// ------------------------------------------------------------------------ //
+// Makes an empty w x h map (frees the old one).  Returns false if it's too big or out of memory.
+bool create_map(int32_t w, int32_t h) {
+  destroy_map();
+  if(w < 1 || h < 1 || w > MAP_MAX || h > MAP_MAX) return false;
+  for(map_shift=0; (1 << map_shift) < w + 2; map_shift++);  // Room for the row and the border on both sides
+  for(attr_shift=1; (1 << attr_shift) < w; attr_shift++);   // Rows are whole bytes
+  map_solid = malloc(((((h + 2) << map_shift) + 31) >> 5) * sizeof(uint32_t));
+  map_attr = malloc((h << attr_shift) / 2);
+  if(!map_solid || !map_attr) {destroy_map(); return false;}
+  map_w = w; map_h = h;
+  clear_map(0);
+  return true;
+}
+
+void destroy_map() {
+  close_world();
+  free(map_solid); map_solid = NULL;
+  free(map_attr);  map_attr = NULL;
+  map_w = map_h = 0;
+  change_log[map_changes % MAP_CHANGE_LOG].x = -1;
+  map_changes++;
+}
+
+// Which square change number `change` (map_changes counted up from it) was to.  False if it was to the whole map,
+// or it's too long ago to remember (more than MAP_CHANGE_LOG changes back).
+bool map_change(uint32_t change, int32_t *x, int32_t *y) {
+  if(map_changes - change > MAP_CHANGE_LOG || change_log[change % MAP_CHANGE_LOG].x < 0) return false;
+  *x = change_log[change % MAP_CHANGE_LOG].x;
+  *y = change_log[change % MAP_CHANGE_LOG].y;
+  return true;
+}
+
+// Fills the map with value, and (re)builds the solid border around it
+void clear_map(int8_t value) {
+  memset(map_solid, 0xFF, ((((map_h + 2) << map_shift) + 31) >> 5) * sizeof(uint32_t));  // Border (and row padding) is solid
+  for (int16_t y=0; y<map_h; y++) for (int16_t x=0; x<map_w; x++) setcell(x, y, value);
+}
+
+void GenerateRandomMap() {
+  clear_map(0);
+  for (int16_t y=0; y<map_h; y++) for (int16_t x=0; x<map_w; x++) setcell(x, y, rand() % 3 == 0 ? 1 : 0);       // Randomly 1/3 of spots are normal [type 1] blocks
+  for (int16_t y=0; y<map_h; y++) for (int16_t x=0; x<map_w; x++) if(getcell(x, y)==1 && rand()%10==0) setcell(x, y, 2); // Changes 10% of normal blocks to [type 2] blocks
+  //for (int16_t y=0; y<map_h; y++) for (int16_t x=0; x<map_w; x++) if(getcell(x, y)==2 && rand()%2==0) setcell(x, y, 3);  // Changes 50% of [type 2] blocks to [type 3] blocks
+}
+
+// Maze random numbers: xorshift32, so a seed digs the same maze on the watch and on the host
+static uint32_t maze_random(uint32_t *state) {
+  *state ^= *state << 13; *state ^= *state >> 17; *state ^= *state << 5;
+  return *state;
+}
+
+static const uint8_t maze_orders[24][4] = {  // Every order to try the 4 directions in
+  {0,1,2,3}, {0,1,3,2}, {0,2,1,3}, {0,2,3,1}, {0,3,1,2}, {0,3,2,1},
+  {1,0,2,3}, {1,0,3,2}, {1,2,0,3}, {1,2,3,0}, {1,3,0,2}, {1,3,2,0},
+  {2,0,1,3}, {2,0,3,1}, {2,1,0,3}, {2,1,3,0}, {2,3,0,1}, {2,3,1,0},
+  {3,0,1,2}, {3,0,2,1}, {3,1,0,2}, {3,1,2,0}, {3,2,0,1}, {3,2,1,0},
+};
+
+typedef struct MazeStepStruct {
+  uint8_t x, y;      // Square (maps are up to MAP_MAX=128 a side)
+  uint8_t order;     // maze_orders[] it tries its directions in
+  uint8_t tried;     // Directions tried so far (bits 0-2), MAZE_DUG_ON if it led anywhere
+} MazeStepStruct;
+#define MAZE_DUG_ON 0x80
+
+// Digs a maze from startx, starty, filling map with (0=empty, 1=wall, -1=special: dead ends)
+// Depth first with an explicit stack: each square on it tries the 4 directions once, in an order picked at
+// random when it was dug, so every square is looked at a fixed number of times (linear in the map size).
+// A square is dug if it's inside the map's edge, still solid, and nothing around it is dug except where it was dug from.
+// Random numbers come from seed alone: the same seed and map size always make the same maze.
+void GenerateMazeMap(int32_t startx, int32_t starty, uint32_t seed) {
+  static const int8_t dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};  // Right, down, left, up
+  uint32_t random = seed ? seed : 1;  // xorshift stays at 0 forever
+  int32_t size = 64, depth = 0;       // Stack grows as needed: a maze's longest path is far shorter than its area
+  MazeStepStruct *stack = malloc(size * sizeof(MazeStepStruct));
+  if(!stack) return;
+
+  clear_map(1);
+  setcell(startx, starty, 0);
+  stack[depth++] = (MazeStepStruct){startx, starty, maze_random(&random) % 24, 0};
+  while(depth > 0) {
+    MazeStepStruct *step = &stack[depth - 1];
+    if((step->tried & 7) == 4) {  // Every direction tried: back up
+      if(!(step->tried & MAZE_DUG_ON) && depth > 1) setcell(step->x, step->y, -1);  // Dead end (the start never is)
+      depth--;
+      continue;
+    }
+    int32_t d = maze_orders[step->order][step->tried++ & 7];
+    int32_t x = step->x + dx[d], y = step->y + dy[d];
+    if(x < 1 || y < 1 || x >= map_w - 1 || y >= map_h - 1 || !solid(x, y)) continue;  // Edge, or already dug
+    bool touches = false;
+    for(int32_t n=0; n<4; n++)
+      if(n != ((d + 2) & 3) && !solid(x + dx[n], y + dy[n])) touches = true;  // Something dug beside it (other than where we are)
+    if(touches) continue;
+
+    step->tried |= MAZE_DUG_ON;
+    if(depth == size) {
+      MazeStepStruct *bigger = realloc(stack, size * 2 * sizeof(MazeStepStruct));
+      if(!bigger) break;  // Out of memory: the maze stops here (it's still a maze)
+      stack = bigger; size *= 2;
+    }
+    setcell(x, y, 0);
+    stack[depth++] = (MazeStepStruct){x, y, maze_random(&random) % 24, 0};
+  }
+  free(stack);
+}
+
+// value: 0=empty, -1=special, 1 to VOID_BLOCK-1 = block type (anything else is a normal block)
+void setcell(int32_t x, int32_t y, int8_t value) {
+  uint32_t i = (y << attr_shift) + x, shift = (i & 1) << 2;
+  uint8_t attr = value < 0 ? SPECIAL_BIT : value < VOID_BLOCK ? value : 1;
+  map_attr[i >> 1] = (map_attr[i >> 1] & ~(15 << shift)) | (attr << shift);
+  i = solid_bit(x, y);
+  if(value > 0) map_solid[i >> 5] |= 1u << (i & 31); else map_solid[i >> 5] &= ~(1u << (i & 31));
+  change_log[map_changes % MAP_CHANGE_LOG].x = x;
+  change_log[map_changes % MAP_CHANGE_LOG].y = y;
+  map_changes++;
+}
+
+void setmap(int32_t x, int32_t y, int8_t value) {
+  x=x>>6; y=y>>6;
+  if ((x >= 0) && (x < map_w) && (y >= 0) && (y < map_h) && !map_streamed)  // Streamed worlds are read-only
+    setcell(x, y, value);
+}
+
+
+// ------------------------------------------------------------------------ //
+
+void walk(int32_t direction, int32_t distance) {
+  int32_t dx = (cos_lookup(direction) * distance) / TRIG_MAX_RATIO;
+  int32_t dy = (sin_lookup(direction) * distance) / TRIG_MAX_RATIO;
+  if(!solid((player.x + dx) >> 6, player.y >> 6) || (IDCLIP && getmap(player.x + dx, player.y) != VOID_BLOCK)) player.x += dx;
+  if(!solid(player.x >> 6, (player.y + dy) >> 6) || (IDCLIP && getmap(player.x, player.y + dy) != VOID_BLOCK)) player.y += dy;
+}
@@ -0,0 +1,139 @@
+#include "main.h"
+
+// ------------------------------------------------------------------------ //
+//  Minimap
+// ------------------------------------------------------------------------ //
+// The map rarely changes, so instead of working out every pixel every frame, draw_map keeps the squares around
+// the player drawn at the current zoom in a 1-bit cache (MINIMAP_PX a side), and copies the part the box shows
+// into the framebuffer a word at a time.  When the map changes only the squares setcell touched are redrawn
+// (map_change), and the cache is only rebuilt when the box scrolls off it, the zoom changes, or the whole map does.
+// options.cached_map = false draws every pixel every frame instead (the host benchmark compares the two).
+#define MINIMAP_PX 128                        // Cache size in pixels (MINIMAP_PX/zoom squares a side).  Boxes up to this big
+#define MINIMAP_WORDS (MINIMAP_PX / 32)       // Words per cache row
+#define SCREEN_W 144
+#define SCREEN_H 168
+
+static uint32_t cache[MINIMAP_PX][MINIMAP_WORDS];
+static int32_t cache_x, cache_y;              // Square in the cache's top left corner (can be off the map)
+static int32_t cache_zoom = 0;                // Zoom it was drawn at (0 = nothing cached)
+static uint32_t cache_changes;                // map_changes it's up to date with
+
+// Draws square x,y into the cache (if it's in it): white if solid, black if not or off the map
+static void cache_square(int32_t x, int32_t y) {
+  int32_t px = (x - cache_x) * cache_zoom, py = (y - cache_y) * cache_zoom, n = cache_zoom;
+  if(px < 0 || py < 0 || px + n > MINIMAP_PX || py + n > MINIMAP_PX) return;
+  bool on = x >= 0 && y >= 0 && x < map_w && y < map_h && solid(x, y);
+  for(int32_t row=py; row<py+n; row++)
+    for(int32_t bit=px, left=n; left>0; ) {  // n pixels from px (across a word boundary if zoom doesn't divide 32)
+      int32_t count = 32 - (bit & 31) < left ? 32 - (bit & 31) : left;
+      uint32_t mask = (count == 32 ? 0xFFFFFFFF : (1u << count) - 1) << (bit & 31);
+      if(on) cache[row][bit >> 5] |= mask; else cache[row][bit >> 5] &= ~mask;
+      bit += count; left -= count;
+    }
+}
+
+// Redraws the whole cache, centered on square x,y
+static void build_cache(int32_t x, int32_t y, int32_t zoom) {
+  int32_t squares = MINIMAP_PX / zoom;
+  cache_zoom = zoom;
+  cache_x = x - squares / 2; cache_y = y - squares / 2;
+  memset(cache, 0, sizeof(cache));
+  for(int32_t sy=cache_y; sy<cache_y+squares; sy++)
+    for(int32_t sx=cache_x; sx<cache_x+squares; sx++)
+      cache_square(sx, sy);
+  cache_changes = map_changes;
+}
+
+// 32 cached pixels of a row from pixel px (pixels off the cache are black)
+static inline uint32_t cache_bits(const uint32_t *row, int32_t px) {
+  if(px <= -32 || px >= MINIMAP_PX) return 0;
+  if(px < 0) return row[0] << -px;
+  uint32_t bits = row[px >> 5] >> (px & 31);
+  if((px & 31) && (px >> 5) + 1 < MINIMAP_WORDS) bits |= row[(px >> 5) + 1] << (32 - (px & 31));
+  return bits;
+}
+
+static void draw_map_cached(GContext *ctx, GRect box, int32_t zoom) {
+  uint32_t *ctx32 = ((uint32_t*)(((GBitmap*)ctx)->addr));
+  int32_t left = ((player.x*zoom)>>6) - (box.size.w/2), top = ((player.y*zoom)>>6) - (box.size.h/2);  // Box's top left, in zoomed map pixels
+
+  // Bring the cache up to date: just the squares that changed, unless it's too many or the box scrolled off it
+  if(zoom != cache_zoom || map_changes - cache_changes > MAP_CHANGE_LOG ||
+     left < cache_x * zoom || top < cache_y * zoom || left + box.size.w > (cache_x * zoom) + MINIMAP_PX || top + box.size.h > (cache_y * zoom) + MINIMAP_PX) {
+    build_cache(player.x >> 6, player.y >> 6, zoom);
+  } else {
+    for(int32_t x, y; cache_changes != map_changes; cache_changes++)
+      if(map_change(cache_changes, &x, &y)) cache_square(x, y);
+      else {build_cache(player.x >> 6, player.y >> 6, zoom); break;}
+  }
+
+  // Copy it in a word at a time, clipped to the screen
+  int32_t x0 = box.origin.x > 0 ? box.origin.x : 0, x1 = box.origin.x + box.size.w < SCREEN_W ? box.origin.x + box.size.w : SCREEN_W;
+  int32_t y0 = box.origin.y > 0 ? box.origin.y : 0, y1 = box.origin.y + box.size.h < SCREEN_H ? box.origin.y + box.size.h : SCREEN_H;
+  if(x0 >= x1 || y0 >= y1) return;
+  left -= cache_x * zoom; top -= cache_y * zoom;  // Now in cache pixels
+  for(int32_t word=x0>>5; word<=(x1-1)>>5; word++) {
+    int32_t lo = x0 > word*32 ? x0 - word*32 : 0, hi = x1 < word*32+32 ? x1 - word*32 : 32;
+    uint32_t mask = (hi - lo == 32) ? 0xFFFFFFFF : ((1u << (hi - lo)) - 1) << lo;  // Box's pixels in this word
+    int32_t px = left + word*32 - box.origin.x;  // Cache pixel at bit 0 of this word
+    for(int32_t y=y0; y<y1; y++) {
+      uint32_t *out = &ctx32[y * 5 + word];
+      *out = (*out & ~mask) | (cache_bits(cache[top + y - box.origin.y], px) & mask);
+    }
+  }
+}
+
+// Every pixel every frame, straight from the map (doesn't handle drawing beyond screen boundaries)
+// 1-pixel-per-square map:
+//   for (int16_t x = 0; x < map_w; x++) for (int16_t y = 0; y < map_h; y++) {graphics_context_set_stroke_color(ctx, solid(x, y)?1:0); graphics_draw_pixel(ctx, GPoint(x, y));}
+static void draw_map_pixels(GContext *ctx, GRect box, int32_t zoom) {
+  uint32_t *ctx32 = ((uint32_t*)(((GBitmap*)ctx)->addr));
+  uint32_t xbit;
+  int32_t x, y, yaddr, xaddr, xonmap, yonmap, yonmapinit;
+
+  xonmap = ((player.x*zoom)>>6) - (box.size.w/2);  // Divide by ZOOM to get map X coord, but rounds [-ZOOM to 0] to 0 and plots it, so divide by ZOOM after checking if <0
+  yonmapinit = ((player.y*zoom)>>6) - (box.size.h/2);
+  for(x=0; x<box.size.w; x++, xonmap++) {
+    xaddr = (x+box.origin.x) >> 5;        // X memory address
+    xbit = ~(1<<((x+box.origin.x) & 31)); // X bit shift level (normally wouldn't ~ it, but ~ is used more often than not)
+    if(xonmap>=0 && xonmap<(map_w*zoom)) {
+      yonmap = yonmapinit;
+      yaddr = box.origin.y * 5;           // Y memory address
+      for(y=0; y<box.size.h; y++, yonmap++, yaddr+=5) {
+        if(yonmap>=0 && yonmap<(map_h*zoom)) {               // If within Y bounds
+          if(solid(xonmap/zoom, yonmap/zoom))                //   Map shows a wall >0
+            ctx32[xaddr + yaddr] |= ~xbit;                   //     White dot
+          else                                               //   Map shows <= 0
+            ctx32[xaddr + yaddr] &= xbit;                    //     Black dot
+        } else {                                             // Else: Out of Y bounds
+          ctx32[xaddr + yaddr] &= xbit;                      //   Black dot
+        }
+      }
+    } else {                                // Out of X bounds: Black vertical stripe
+      for(yaddr=box.origin.y*5; yaddr<((box.size.h + box.origin.y)*5); yaddr+=5)
+        ctx32[xaddr + yaddr] &= xbit;
+    }
+  }
+}
+
+// size x size square from x,y, straight into the framebuffer like the map itself (the minimap has its own
+// layer on the watch, and graphics_ calls there are offset by its frame).  Clipped to the box and the screen
+static void draw_square(GContext *ctx, GRect box, int32_t x0, int32_t y0, int32_t size, uint8_t color) {
+  uint32_t *ctx32 = ((uint32_t*)(((GBitmap*)ctx)->addr));
+  for(int32_t y=y0; y<y0+size; y++)
+    for(int32_t x=x0; x<x0+size; x++)
+      if(x >= box.origin.x && y >= box.origin.y && x < box.origin.x + box.size.w && y < box.origin.y + box.size.h &&
+         x >= 0 && y >= 0 && x < SCREEN_W && y < SCREEN_H) {
+        if(color) ctx32[y * 5 + (x >> 5)] |= 1u << (x & 31);
+        else      ctx32[y * 5 + (x >> 5)] &= ~(1u << (x & 31));
+      }
+}
+
+void draw_map(GContext *ctx, GRect box, int32_t zoom) {
+  PROFILE_SCOPE(PROFILE_MAP);
+  if(options.cached_map) draw_map_cached(ctx, box, zoom); else draw_map_pixels(ctx, box, zoom);
+  int32_t cx = box.origin.x + box.size.w/2, cy = box.origin.y + box.size.h/2;  // Player's spot
+  for(int32_t a=0; a<agent_count; a++)  // Agents: solid 2x2 dots
+    draw_square(ctx, box, cx + (((agents[a].x - player.x) * zoom) >> 6), cy + (((agents[a].y - player.y) * zoom) >> 6), 2, 1);
+  draw_square(ctx, box, cx - 1, cy - 1, 3, map_cursor_color());  // Flashing dot.  The border is the HUD's (draw_frame)
+}
@@ -0,0 +1,58 @@
+#include "main.h"
+
+// ------------------------------------------------------------------------ //
+//  Hot-path Profiling
+// ------------------------------------------------------------------------ //
+// Only compiled in with ENGINE_PROFILE.  PROFILE_SCOPE adds the time until the end of its block to a stage of
+// the current frame, profile_end_frame files the frame away in a ring of the last PROFILE_FRAMES frames, and
+// profile_summary gives min/avg/p95 over the ring.
+#ifdef ENGINE_PROFILE
+
+const char *const profile_names[PROFILE_VALUES] = {
+  [PROFILE_RAYS] = "rays", [PROFILE_WALLS] = "walls", [PROFILE_FLOOR] = "floor", [PROFILE_SPRITES] = "sprites",
+  [PROFILE_MAP] = "map", [PROFILE_TEXT] = "text", [PROFILE_FRAME] = "frame", [PROFILE_RAY_COUNT] = "#rays",
+};
+
+uint32_t profile_now[PROFILE_STAGES];           // This frame so far (us)
+static uint32_t profile_ring[PROFILE_FRAMES][PROFILE_VALUES];
+static uint32_t profile_count = 0;              // Frames in the ring (up to PROFILE_FRAMES)
+static uint32_t profile_next = 0;               // Where the next frame goes
+static uint32_t profile_rays = 0;               // stats.rays at the end of the last frame
+
+// Files this frame's timings (and rays cast) in the ring and starts a new frame.
+// Returns true every PROFILE_FRAMES frames, when the whole ring is new (a good time to log it).
+bool profile_end_frame(void) {
+  uint32_t *frame = profile_ring[profile_next];
+  for(int32_t i=0; i<PROFILE_STAGES; i++) {frame[i] = profile_now[i]; profile_now[i] = 0;}
+  frame[PROFILE_RAY_COUNT] = stats.rays - profile_rays;
+  profile_rays = stats.rays;
+  if(profile_count < PROFILE_FRAMES) profile_count++;
+  profile_next = (profile_next + 1) % PROFILE_FRAMES;
+  return profile_next == 0;
+}
+
+// min/avg/p95 of one stage (or PROFILE_RAY_COUNT) over the frames in the ring.  All 0 if there are none yet.
+ProfileSummaryStruct profile_summary(int32_t value) {
+  uint32_t sorted[PROFILE_FRAMES], total = 0;
+  ProfileSummaryStruct summary = {0, 0, 0};
+  if(profile_count == 0) return summary;
+
+  for(uint32_t i=0; i<profile_count; i++) {       // Insertion sort: only PROFILE_FRAMES values
+    uint32_t v = profile_ring[i][value], j = i;
+    total += v;
+    for(; j>0 && sorted[j-1] > v; j--) sorted[j] = sorted[j-1];
+    sorted[j] = v;
+  }
+  summary.min = sorted[0];
+  summary.avg = total / profile_count;
+  summary.p95 = sorted[(profile_count * 95 + 99) / 100 - 1];
+  return summary;
+}
+
+void profile_reset(void) {
+  profile_count = profile_next = 0;
+  profile_rays = stats.rays;
+  for(int32_t i=0; i<PROFILE_STAGES; i++) profile_now[i] = 0;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "main.h"
+
+RayStruct ray;
+
+// Ray went past range (or its budget of grid lines, which a ray within range never runs out of)
+static int32_t out_of_range_of(RayStruct *r, int32_t range) {
+  r->hit = 0;
+  r->dist = range;
+  return -1;
+}
+static int32_t out_of_range(void) {return out_of_range_of(&ray, options.range);}
+
+//shoot_ray(x, y, angle)
+//  x, y = position on map to shoot the ray from
+//  angle = direction to shoot the ray (in Pebble angle notation)
+// returns int32_t: end result of the function
+//              -1: Ray went further than options.range without hitting a block (ray.dist = options.range)
+//               0: Ray went out of bounds of the map before hitting a block (hit the VOID_BLOCK border: ray.dist is how far)
+//               1: Successfully hit a block and stopped
+//modifies: global RayStruct ray
+// Every ray stops after ray_budget(options.range) grid lines, even one stuck bouncing between mirrors,
+// so a frame never costs more than view width * ray_budget steps.
+int32_t shoot_ray(int32_t x, int32_t y, int32_t angle) {
+  int32_t sin, cos, dx, dy, nx, ny, steps = ray_budget(options.range);
+  uint32_t dist = 0;  // Length of the legs before the last mirror
+
+  sin = sin_lookup(angle);
+  cos = cos_lookup(angle);
+  if(options.dda) return shoot_ray_dda(x, y, cos, sin);
+  ray = (RayStruct){.x=x, .y=y};
+  STAT(rays, 1);
+
+  while(true) {
+    ny = sin>0 ? 64 : -1;             // Next grid lines are this far into a square (set again after bouncing off a mirror)
+    nx = cos>0 ? 64 : -1;
+    dy = ny - (ray.y&63);
+    dx = nx - (ray.x&63);
+    STAT(ray_steps, 1);
+    if(--steps < 0) return out_of_range();  // Stop ray after traveling too far
+
+    if(abs32((ray.x + dx - x) * sin) < abs32((ray.y + dy - y) * cos)) {  // Which grid line comes first, both measured from the start of the leg
+      ray.x += dx;
+      ray.y = y + ((ray.x - x) * sin) / cos;  // From the start of the leg, not the last crossing: rounded once, so it doesn't drift
+      ray.hit = getmap(ray.x, ray.y);
+      if(ray.hit > 0) {               // if ray hits a wall (a block)
+        ray.dist = dist + ((ray.x - x) << 16) / cos; // Distance ray traveled
+        if(ray.dist > (uint32_t)options.range) return out_of_range();
+        if(material(ray.hit)->mirror) { // if it hit a mirror block
+          cos = -1 * cos;             // Bounce ray off mirror (ray will continue)
+          ray.bounces++;
+          x = ray.x; y = ray.y; dist = ray.dist;  // Next leg starts here
+        } else {
+          ray.offset = ray.y&63;      // Get offset: offset is where on wall ray hits: 0 (left edge) to 63 (right edge)
+          ray.face = cos>0 ? 0 : 2;
+          return ray.hit != VOID_BLOCK; // Returning a "1" means "ray hit a wall", "0" means it ran off the map
+        } // End else Mirror
+      } // End if hit
+    } else {
+      ray.y += dy;
+      ray.x = x + ((ray.y - y) * cos) / sin;
+      ray.hit = getmap(ray.x, ray.y);
+      if(ray.hit > 0) {               // if ray hits a wall (a block)
+        ray.dist = dist + ((ray.y - y) << 16) / sin; // Distance ray traveled    <<16 = * TRIG_MAX_RATIO
+        if(ray.dist > (uint32_t)options.range) return out_of_range();
+        if(material(ray.hit)->mirror) { // if it hit a mirror block
+          sin = -1 * sin;             // Bounce ray off mirror (ray will continue)
+          ray.bounces++;
+          x = ray.x; y = ray.y; dist = ray.dist;
+        } else {
+         ray.offset = ray.x&63;        // Get offset: offset is where on wall ray hits: 0 (left edge) to 63 (right edge)
+         ray.face = sin>0 ? 1 : 3;
+         return ray.hit != VOID_BLOCK;  // Returning a "1" means "ray hit a wall", "0" means it ran off the map
+        } // End else Mirror
+      } // End if hit
+    } // End else Xlen<Ylen
+  } //End While
+}
+
+// ------------------------------------------------------------------------ //
+
+// ------------------------------------------------------------------------ //
+//  Seen Squares
+// ------------------------------------------------------------------------ //
+// While draw_3D casts the view, every square its rays go through (up to the first wall or mirror) is marked in
+// seen[], laid out like map_solid.  draw_3D draws sprites on marked squares without checking them against the
+// walls first.  Only rays actually cast mark squares (not columns worked out from their neighbours), so a square
+// that isn't marked may still be in view: its sprites get checked against the walls instead.
+// Line of sight queries don't use the marks: a ray through a square from somewhere in the eye's square doesn't
+// mean the line between two exact points misses every corner, so they always walk (sight).
+// Marks build up while the eye stays put (turning on the spot sees more), and are cleared when it moves or the
+// map changes.  None on a streamed world.
+static uint32_t *seen = NULL;         // 1 bit per map_solid bit
+static uint32_t *seen_record = NULL;  // seen while draw_3D is casting, else NULL
+static int32_t seen_words = 0;
+static int32_t seen_x, seen_y;        // Eye the marks are from (pixels)
+static uint32_t seen_changes;         // map_changes they're up to date with
+static bool seen_valid = false;
+
+// Returns false if the marks were just cleared (or there were none), so last frame's rays haven't marked anything yet
+bool begin_seen(int32_t x, int32_t y) {
+  int32_t words = (((map_h + 2) << map_shift) + 31) >> 5;
+  seen_record = NULL;
+  if(map_streamed || !map_solid || !options.seen_cells) {seen_valid = false; return true;}  // Nothing to mark
+  if(words != seen_words) {
+    free(seen);
+    seen = malloc(words * sizeof(uint32_t));
+    seen_words = seen ? words : 0;
+    seen_valid = false;
+    if(!seen) return true;
+  }
+  bool kept = seen_valid && x == seen_x && y == seen_y && seen_changes == map_changes;
+  if(!kept) memset(seen, 0, words * sizeof(uint32_t));
+  seen_x = x; seen_y = y; seen_changes = map_changes; seen_valid = true;
+  seen_record = seen;
+  return kept;
+}
+
+void end_seen(void) {seen_record = NULL;}
+
+// Eye's square, if the marks are still good
+static bool seen_eye(int32_t *ex, int32_t *ey) {
+  if(!seen_valid || seen_changes != map_changes || map_streamed) return false;
+  *ex = seen_x >> 6; *ey = seen_y >> 6;
+  return true;
+}
+
+// Whether a ray from x,y (pixels) went through square sx,sy, as far as the marks know
+bool seen_square(int32_t x, int32_t y, int32_t sx, int32_t sy) {
+  int32_t ex, ey;
+  if(!seen_eye(&ex, &ey) || x != seen_x || y != seen_y || sx < 0 || sy < 0 || sx >= map_w || sy >= map_h) return false;
+  uint32_t bit = solid_bit(sx, sy);
+  return (seen[bit >> 5] >> (bit & 31)) & 1;
+}
+
+// ------------------------------------------------------------------------ //
+
+//shoot_ray_dda(x, y, cos, sin)
+//  Same results and return values as shoot_ray, but walks the grid without dividing on every step.
+//  x, y must be on the map (or in the border).
+//  cos, sin = direction to shoot the ray.  Doesn't need to be a unit vector (any length up to 2x TRIG_MAX_RATIO)
+//
+//  How it works: shoot_ray compares dx*sin against dy*cos every step to see which grid line comes next,
+//  with dx and dy measured from the start of the leg, then divides to find where on that line the ray is.
+//  Here the two products are kept running instead: they only ever grow by 64*sin or 64*cos per crossing,
+//  so it's an add and a compare per step.  Both round the hit point once, the same way, so they agree exactly.
+//  The only divisions are the two at the end to find where on the wall it hit and how far away that is.
+//  The grid walk only reads map_solid, stepping its bit index along (±1 across, ±1 row down), or asks the chunk cache
+//  in a streamed world; the block type is only looked up once something solid is hit.
+//  ray.dist uses the same formula as shoot_ray, so it's bit-for-bit the same whenever both hit the same face.
+//  ray.dist (and so options.range) is measured in lengths of cos,sin: from draw_3D that's distance from the camera plane.
+//  Same step budget as shoot_ray: the grid walk is at most ray_budget(options.range) steps, mirrors included.
+//  trace does the work, re-entrantly: into *r, out to range, marking the squares it goes through in record (if not NULL).
+static int32_t trace(RayStruct *r, int32_t x, int32_t y, int32_t cos, int32_t sin, int32_t range, uint32_t *record) {
+  int32_t mapx, mapy, stepx, stepy, cell, bit, bitx, bity, steps = ray_budget(range);
+  bool streamed = map_streamed;
+  uint32_t xlen, ylen, xstep, ystep, dist = 0;  // dist = length of previous legs (only non-zero after a mirror)
+
+  STAT(rays, 1);
+  r->bounces = 0;
+  while(true) {  // Once per leg of the ray (mirrors start a new leg)
+    stepx = cos>0 ? 1 : -1;
+    stepy = sin>0 ? 1 : -1;
+    xlen = (cos>0 ? 64 - (x&63) : (x&63) + 1) * abs32(sin);  // Distance to first X crossing * |sin|  (-1 edges, same as shoot_ray's nx,ny)
+    ylen = (sin>0 ? 64 - (y&63) : (y&63) + 1) * abs32(cos);  // Distance to first Y crossing * |cos|
+    xstep = 64 * abs32(sin);
+    ystep = 64 * abs32(cos);
+    mapx = x >> 6;
+    mapy = y >> 6;
+    bit = solid_bit(mapx, mapy);           // map_solid bit of the square the ray is in
+    bitx = stepx;                          // Moving 1 square across
+    bity = stepy * (1 << map_shift);       // Moving 1 square down
+    if(record) record[bit >> 5] |= 1u << (bit & 31);
+
+    while(true) {
+      STAT(ray_steps, 1);
+      if(--steps < 0) return out_of_range_of(r, range);
+      if(xlen < ylen) {                     // X grid line comes first
+        mapx += stepx; bit += bitx;
+        if(streamed ? solid(mapx, mapy) : (map_solid[bit >> 5] >> (bit & 31)) & 1) {
+          cell = getcell_far(mapx, mapy);
+          r->x = (mapx << 6) + (cos>0 ? 0 : 63);
+          r->y = y + ((r->x - x) * sin) / cos;
+          r->dist = dist + ((r->x - x) << 16) / cos;
+          if(r->dist > (uint32_t)range) return out_of_range_of(r, range);
+          if(material(cell)->mirror) {cos = -cos; break;}  // Mirror: bounce off and start a new leg from here
+          r->hit = cell;
+          r->offset = r->y&63;
+          r->face = cos>0 ? 0 : 2;
+          return cell != VOID_BLOCK;          // The border: ran off the map
+        }
+        if(record) record[bit >> 5] |= 1u << (bit & 31);  // The ray went through here
+        xlen += xstep;
+      } else {                              // Y grid line comes first
+        mapy += stepy; bit += bity;
+        if(streamed ? solid(mapx, mapy) : (map_solid[bit >> 5] >> (bit & 31)) & 1) {
+          cell = getcell_far(mapx, mapy);
+          r->y = (mapy << 6) + (sin>0 ? 0 : 63);
+          r->x = x + ((r->y - y) * cos) / sin;
+          r->dist = dist + ((r->y - y) << 16) / sin;
+          if(r->dist > (uint32_t)range) return out_of_range_of(r, range);
+          if(material(cell)->mirror) {sin = -sin; break;}  // Mirror: bounce off and start a new leg from here
+          r->hit = cell;
+          r->offset = r->x&63;
+          r->face = sin>0 ? 1 : 3;
+          return cell != VOID_BLOCK;          // The border: ran off the map
+        }
+        if(record) record[bit >> 5] |= 1u << (bit & 31);
+        ylen += ystep;
+      }
+    } // End Grid Walk (the solid border or the step budget always stops it)
+    x = r->x; y = r->y; dist = r->dist; r->bounces++;
+    record = NULL;  // What's seen in a mirror isn't in sight
+  } // End Legs
+}
+
+int32_t shoot_ray_dda(int32_t x, int32_t y, int32_t cos, int32_t sin) {
+  return trace(&ray, x, y, cos, sin, options.range, seen_record);
+}
+
+// ------------------------------------------------------------------------ //
+//  Ray Queries
+// ------------------------------------------------------------------------ //
+// For gameplay: what a shot hits, and whether one thing can see another.  Everything goes in and comes out
+// through the RayQueryStruct, so queries don't touch the global ray (or each other).
+
+// Line of sight from x0,y0 to x1,y1 (pixels): walks the squares in between the way trace does, with the vector between
+// the two points as the direction, stopping at the first solid one (mirrors too).  Only as many steps as squares crossed.
+// True if it's clear; if not, r->hit is what's in the way, and r->x,y the corner of its square.
+static bool sight(RayStruct *r, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+  int32_t dx = x1 - x0, dy = y1 - y0, mapx = x0 >> 6, mapy = y0 >> 6;
+  int32_t stepx = dx>0 ? 1 : -1, stepy = dy>0 ? 1 : -1;
+  int32_t steps = abs32((x1 >> 6) - mapx) + abs32((y1 >> 6) - mapy);  // Grid lines between the two
+  uint32_t xlen = (dx>0 ? 64 - (x0&63) : (x0&63) + 1) * abs32(dy);    // Same as trace, with dx,dy for cos,sin
+  uint32_t ylen = (dy>0 ? 64 - (y0&63) : (y0&63) + 1) * abs32(dx);
+  uint32_t xstep = 64 * abs32(dy), ystep = 64 * abs32(dx);
+
+  STAT(rays, 1);
+  while(steps-- > 0) {
+    STAT(ray_steps, 1);
+    if(xlen < ylen) {mapx += stepx; xlen += xstep;}
+    else            {mapy += stepy; ylen += ystep;}
+    if(solid(mapx, mapy)) {
+      r->hit = getcell_far(mapx, mapy);
+      r->x = mapx << 6; r->y = mapy << 6;
+      return false;
+    }
+  }
+  return true;
+}
+
+int32_t query_ray(RayQueryStruct *q) {
+  if(q->kind == RAY_SIGHT)
+    q->result = sight(&q->ray, q->x, q->y, q->tox, q->toy);
+  else
+    q->result = trace(&q->ray, q->x, q->y, cos_lookup(q->angle), sin_lookup(q->angle), options.range, NULL);
+  return q->result;
+}
+
+void query_rays(RayQueryStruct *q, int32_t count) {
+  for(int32_t i=0; i<count; i++) query_ray(&q[i]);
+}
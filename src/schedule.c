@@ -0,0 +1,81 @@
+#include "main.h"
+
+// ------------------------------------------------------------------------ //
+//  Frame Pacing
+// ------------------------------------------------------------------------ //
+// The game runs in fixed SIM_TICK_MS ticks (input, walking, collisions), however long frames take to draw.
+// main_loop asks scheduler_update how many ticks are due, runs them, then draws one frame for all of them:
+// if drawing falls behind, frames are dropped but the player still moves at the same speed.
+// It also picks a render quality (options.quality) from how long frames have been taking to draw.
+// Everything works on a millisecond clock passed in (clock_ms() on the watch), so the host can fake one.
+
+void scheduler_start(SchedulerStruct *s, uint32_t now) {
+  *s = (SchedulerStruct){.last = now, .fps_start = now, .quality = QUALITY_FULL, .quality_backoff = QUALITY_HOLD};
+}
+
+// Returns how many simulation ticks are due now (0 if it's early)
+uint32_t scheduler_update(SchedulerStruct *s, uint32_t now) {
+  uint32_t ticks;
+  s->behind += now - s->last;            // Unsigned: fine across the clock wrapping
+  s->last = now;
+  ticks = s->behind / SIM_TICK_MS;
+  if(ticks > SIM_MAX_TICKS) {            // Stalled (or idle) too long to catch up: let the extra time go
+    s->lost_ms += (ticks - SIM_MAX_TICKS) * SIM_TICK_MS;
+    s->behind -= (ticks - SIM_MAX_TICKS) * SIM_TICK_MS;
+    ticks = SIM_MAX_TICKS;
+  }
+  s->behind -= ticks * SIM_TICK_MS;
+  s->ticks += ticks;
+  if(ticks > 1) s->frames_dropped += ticks - 1;  // Ticks that won't get a frame of their own
+  return ticks;
+}
+
+// main_loop is back from idling (backing off while nothing happened): the time since the last update was slept
+// through, not fallen behind, so it isn't caught up.  Catching up would run the first new tilt SIM_MAX_TICKS times
+// over and count the idle wait as dropped frames and lost time.  At most one tick is due.
+void scheduler_resume(SchedulerStruct *s, uint32_t now) {
+  uint32_t due = s->behind + (now - s->last);
+  if(due > SIM_TICK_MS) {s->slept_ms += due - SIM_TICK_MS; due = SIM_TICK_MS;}
+  s->behind = due;
+  s->last = now;
+}
+
+// A frame was drawn, from start to end
+void scheduler_frame(SchedulerStruct *s, uint32_t start, uint32_t end) {
+  s->frame_ms = end - start;
+  s->frame_avg = s->frame_avg - (s->frame_avg >> 3) + (s->frame_ms << 1);  // x16, averaged over about 8 frames
+  if(s->frame_ms > FRAME_BUDGET_MS) s->frames_over++;
+  s->frames++;
+  s->fps_frames++;
+  if(end - s->fps_start >= 1000) {       // Count frames over a second or so: never divides by less than 1000ms
+    s->fps = (s->fps_frames * 1000) / (end - s->fps_start);
+    s->fps_start = end;
+    s->fps_frames = 0;
+  }
+
+  // Render quality: a level down when the average goes over budget, a level up when it's well under.
+  // The gap between the two, and waiting for the average to settle after a change, stop it flipping back and forth.
+  // If a level up goes straight back down (the frames in between were only just fast enough), it waits twice as
+  // long before trying again, up to QUALITY_HOLD_MAX, until a level holds.
+  if(s->quality_hold > 0) {
+    s->quality_hold--;
+  } else if(s->frame_avg > FRAME_BUDGET_MS * 16 && s->quality > 0) {
+    if(s->quality_raised && s->quality_backoff < QUALITY_HOLD_MAX) s->quality_backoff *= 2;
+    s->quality--;
+    s->quality_hold = s->quality_backoff;
+    s->quality_raised = false;
+  } else if(s->frame_avg < (FRAME_BUDGET_MS * 16 * QUALITY_UP_PCT) / 100 && s->quality < QUALITY_FULL) {
+    s->quality++;
+    s->quality_hold = QUALITY_HOLD;
+    s->quality_raised = true;
+  } else {                               // Settled
+    s->quality_backoff = QUALITY_HOLD;
+    s->quality_raised = false;
+  }
+}
+
+// Milliseconds from now until the next tick is due (at least 1)
+uint32_t scheduler_wait(const SchedulerStruct *s, uint32_t now) {
+  int32_t wait = (int32_t)(s->last + SIM_TICK_MS - s->behind - now);
+  return wait > 1 ? wait : 1;
+}
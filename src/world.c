@@ -0,0 +1,93 @@
+#include "main.h"
+
+// ------------------------------------------------------------------------ //
+//  Streamed Worlds
+// ------------------------------------------------------------------------ //
+// Resource layout (little-endian, written by tools/worldgen.py):
+//   uint16 width, height            world size in chunks
+//   chunks, row by row:             CHUNK_SIZE uint16 solid rows (bit x = square x),
+//                                   then CHUNK_SIZE*CHUNK_SIZE/2 bytes of attributes (4 bits per square, like map_attr)
+// Streamed worlds are read-only: setmap does nothing while one is open.
+#define WORLD_HEADER 4
+#define CHUNK_BYTES (CHUNK_SIZE * 2 + CHUNK_SIZE * CHUNK_SIZE / 2)
+#define PREFETCH_CHUNKS 2               // How far ahead of the player to load (in chunks)
+#define PREFETCH_LOADS 2                // Most chunks prefetch_world loads per call (each one is a flash read)
+
+bool map_streamed = false;
+static ChunkStruct chunk_cache[CHUNK_CACHE];
+ChunkStruct *last_chunk = &chunk_cache[0];   // Most lookups land in the same chunk as the one before
+static ResHandle world_handle;
+static int32_t world_cw, world_ch;           // World size in chunks
+static uint32_t chunk_clock = 0;             // Ticks every time a different chunk gets used
+
+static void load_chunk(ChunkStruct *c, int32_t cx, int32_t cy) {
+  uint8_t data[CHUNK_BYTES];
+  resource_load_byte_range(world_handle, WORLD_HEADER + (cy * world_cw + cx) * CHUNK_BYTES, data, CHUNK_BYTES);
+  for(int32_t y=0; y<CHUNK_SIZE; y++) c->solid[y] = data[y * 2] | (data[y * 2 + 1] << 8);
+  memcpy(c->attr, data + CHUNK_SIZE * 2, sizeof(c->attr));
+  c->cx = cx; c->cy = cy;
+}
+
+// Slot holding chunk cx,cy, or the least recently used one if it isn't cached (NULL if off the world)
+static ChunkStruct *cached_chunk(int32_t cx, int32_t cy, bool *found) {
+  ChunkStruct *oldest = &chunk_cache[0];
+  if((uint32_t)cx >= (uint32_t)world_cw || (uint32_t)cy >= (uint32_t)world_ch) return NULL;
+  for(int32_t i=0; i<CHUNK_CACHE; i++) {
+    if(chunk_cache[i].cx == cx && chunk_cache[i].cy == cy) {*found = true; return &chunk_cache[i];}
+    if(chunk_cache[i].used < oldest->used) oldest = &chunk_cache[i];
+  }
+  *found = false;
+  return oldest;
+}
+
+// Slow path of chunk_at: search the cache, loading the chunk (a stall) if it isn't there
+ChunkStruct *find_chunk(int32_t cx, int32_t cy) {
+  bool found;
+  ChunkStruct *c = cached_chunk(cx, cy, &found);
+  if(!c) return NULL;
+  if(!found) {STAT(chunk_stalls, 1); load_chunk(c, cx, cy);}
+  c->used = ++chunk_clock;
+  return last_chunk = c;
+}
+
+// Opens a world resource in place of the map.  Returns false if it isn't a world.
+bool open_world(uint32_t resource_id) {
+  uint8_t header[WORLD_HEADER];
+  destroy_map();
+  world_handle = resource_get_handle(resource_id);
+  if(!world_handle || resource_load_byte_range(world_handle, 0, header, WORLD_HEADER) != WORLD_HEADER) return false;
+  world_cw = header[0] | (header[1] << 8);
+  world_ch = header[2] | (header[3] << 8);
+  if(world_cw < 1 || world_ch < 1 || resource_size(world_handle) < (size_t)(WORLD_HEADER + world_cw * world_ch * CHUNK_BYTES)) return false;
+
+  for(int32_t i=0; i<CHUNK_CACHE; i++) chunk_cache[i] = (ChunkStruct){.cx = NO_CHUNK, .cy = NO_CHUNK, .used = 0};
+  last_chunk = &chunk_cache[0];
+  map_w = world_cw * CHUNK_SIZE;
+  map_h = world_ch * CHUNK_SIZE;
+  map_streamed = true;
+  return true;
+}
+
+void close_world() {
+  map_streamed = false;
+  world_handle = NULL;
+}
+
+// Loads the chunks the player is about to look at: straight ahead and either edge of the view,
+// 1 to PREFETCH_CHUNKS chunks out.  Call once a frame.  Chunks already cached count as just used,
+// so they don't get evicted; at most PREFETCH_LOADS missing ones get loaded.
+void prefetch_world(int32_t x, int32_t y, int32_t facing) {
+  int32_t loads = 0;
+  if(!map_streamed) return;
+  for(int32_t d=1; d<=PREFETCH_CHUNKS; d++)
+    for(int32_t side=-1; side<=1; side++) {
+      int32_t angle = facing + side * (fov / 2);
+      int32_t px = (x + ((cos_lookup(angle) * (d * CHUNK_SIZE * 64)) / TRIG_MAX_RATIO)) >> 6;  // Square d chunks out that way
+      int32_t py = (y + ((sin_lookup(angle) * (d * CHUNK_SIZE * 64)) / TRIG_MAX_RATIO)) >> 6;
+      bool found;
+      ChunkStruct *c = cached_chunk(px >> CHUNK_SHIFT, py >> CHUNK_SHIFT, &found);
+      if(!c || (!found && loads >= PREFETCH_LOADS)) continue;
+      if(!found) {STAT(chunk_prefetches, 1); load_chunk(c, px >> CHUNK_SHIFT, py >> CHUNK_SHIFT); loads++;}
+      c->used = ++chunk_clock;
+    }
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+#
+# Converts the 64x64 PNGs listed in resources/textures.json into 1-bit textures
+# the renderer can sample without going through GBitmap.
+#
+#   texgen.py textures.json resources_dir out.c out.h
+#
+# textures.json is a list of {"file": ..., "name": ...} like appinfo.json's
+# media entries.  They're kept out of appinfo.json so the PNGs, which are
+# compiled into the app, don't ship a second time as resources.
+#
+# Each PNG row is one texture column (that's how the wall art is drawn, on its
+# side), so a texture is 64 columns of 64 texels, 2 words per column:
+# texel v of column u is bit (v & 31) of word [u * 2 + (v >> 5)], v=0 = top.
+# Columns are stored one after the other, so stepping down a wall column reads
+# 2 neighbouring words.  Pixels are white when opaque and at least 50% bright,
+# same as the SDK's 1-bit bitmap conversion.
+#
+# PNGs named SPRITE_* are sprites instead: same layout, but each column is
+# followed by 2 words of mask (bit set where the pixel is at least 50%
+# opaque), so a sprite column is 4 neighbouring words.
+#
+# Pure python (zlib + struct) so it runs inside the Pebble SDK's waf build
+# and the host Makefile without extra modules.
+import json, os, struct, sys, zlib
+
+SIZE = 64
+
+def read_png(path):
+  data = open(path, 'rb').read()
+  if data[:8] != b'\x89PNG\r\n\x1a\n': raise ValueError('%s: not a PNG' % path)
+  pos, idat, palette, alpha = 8, b'', None, None
+  while pos < len(data):
+    length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+    chunk = data[pos + 8:pos + 8 + length]
+    pos += length + 12
+    if kind == b'IHDR': width, height, depth, color, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+    elif kind == b'PLTE': palette = [tuple(bytearray(chunk[i:i + 3])) for i in range(0, len(chunk), 3)]
+    elif kind == b'tRNS': alpha = bytearray(chunk)
+    elif kind == b'IDAT': idat += chunk
+  if interlace: raise ValueError('%s: interlaced PNGs are not supported' % path)
+  if depth == 16: raise ValueError('%s: 16-bit PNGs are not supported' % path)
+
+  channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+  bpp = max(1, channels * depth // 8)               # Bytes per pixel for filtering
+  stride = (width * channels * depth + 7) // 8
+  raw, rows, prev = bytearray(zlib.decompress(idat)), [], bytearray(stride)
+  for y in range(height):
+    kind, line = raw[y * (stride + 1)], raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)]
+    for i in range(stride):
+      a = line[i - bpp] if i >= bpp else 0
+      b, c = prev[i], (prev[i - bpp] if i >= bpp else 0)
+      if kind == 1: line[i] = (line[i] + a) & 255
+      elif kind == 2: line[i] = (line[i] + b) & 255
+      elif kind == 3: line[i] = (line[i] + (a + b) // 2) & 255
+      elif kind == 4:
+        p = a + b - c
+        pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+        line[i] = (line[i] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 255
+    prev = line
+
+    samples = [(line[(i * depth) // 8] >> (8 - depth - (i * depth) % 8)) & ((1 << depth) - 1) for i in range(width * channels)]
+    scale = 255 // ((1 << depth) - 1)
+    pixels = []
+    for x in range(width):
+      s = samples[x * channels:(x + 1) * channels]
+      if color == 3:
+        r, g, b = palette[s[0]]
+        pixels.append((r, g, b, alpha[s[0]] if alpha and s[0] < len(alpha) else 255))
+      elif color == 0: pixels.append((s[0] * scale,) * 3 + (255,))
+      elif color == 4: pixels.append((s[0] * scale,) * 3 + (s[1] * scale,))
+      elif color == 2: pixels.append((s[0], s[1], s[2], 255))
+      else: pixels.append(tuple(s))
+    rows.append(pixels)
+  return width, height, rows
+
+def texture_words(rows, masked=False):
+  words = []
+  for row in rows:                                  # PNG row = texture column
+    bits = mask = 0
+    for v, (r, g, b, a) in enumerate(row):
+      if a >= 128 and (r * 299 + g * 587 + b * 114) // 1000 >= 128: bits |= 1 << v
+      if a >= 128: mask |= 1 << v
+    words += [bits & 0xffffffff, bits >> 32]
+    if masked: words += [mask & 0xffffffff, mask >> 32]
+  return words
+
+def write_words(f, name, file, words):
+  f.write('  [%s] = {  // %s\n' % (name, file))
+  for i in range(0, len(words), 8): f.write('    ' + ', '.join('0x%08x' % w for w in words[i:i + 8]) + ',\n')
+  f.write('  },\n')
+
+def main(texture_list, resource_dir, out_c, out_h):
+  textures, sprites = [], []
+  for entry in json.load(open(texture_list)):
+    width, height, rows = read_png(os.path.join(resource_dir, entry['file']))
+    if (width, height) != (SIZE, SIZE): raise ValueError('%s: must be %dx%d' % (entry['file'], SIZE, SIZE))
+    if entry['name'].startswith('SPRITE_'): sprites.append((entry['name'], entry['file'], texture_words(rows, True)))
+    else: textures.append((entry['name'], entry['file'], texture_words(rows)))
+
+  header = '// Generated by tools/texgen.py from the PNGs in resources/textures.json.  Do not edit.\n'
+  with open(out_h, 'w') as f:
+    f.write(header + '#pragma once\n#include <stdint.h>\n\n')
+    f.write('#define TEXTURE_SIZE %d                // Texels across and down\n' % SIZE)
+    f.write('#define TEXTURE_WORDS (TEXTURE_SIZE * TEXTURE_SIZE / 32)\n\n')
+    f.write('enum {\n')
+    for name, file, _ in textures: f.write('  TEXTURE_%s,\n' % name)
+    f.write('  TEXTURE_COUNT\n};\n\n')
+    f.write('// texture_data[id][u * 2 + (v >> 5)] bit (v & 31) = texel v (down) of column u (across)\n')
+    f.write('extern const uint32_t texture_data[TEXTURE_COUNT][TEXTURE_WORDS];\n\n')
+    f.write('enum {\n')
+    for name, file, _ in sprites: f.write('  %s,\n' % name)
+    f.write('  SPRITE_COUNT\n};\n\n')
+    f.write('// sprite_data[id][u * 4 + (v >> 5)] bit (v & 31) = texel v of column u, [u * 4 + 2 + (v >> 5)] = its mask (1 = drawn)\n')
+    f.write('extern const uint32_t sprite_data[SPRITE_COUNT][TEXTURE_WORDS * 2];\n')
+  with open(out_c, 'w') as f:
+    f.write(header + '#include "%s"\n\n' % os.path.basename(out_h))
+    f.write('const uint32_t texture_data[TEXTURE_COUNT][TEXTURE_WORDS] = {\n')
+    for name, file, words in textures: write_words(f, 'TEXTURE_' + name, file, words)
+    f.write('};\n\n')
+    f.write('const uint32_t sprite_data[SPRITE_COUNT][TEXTURE_WORDS * 2] = {\n')
+    for name, file, words in sprites: write_words(f, name, file, words)
+    f.write('};\n')
+
+if __name__ == '__main__':
+  if len(sys.argv) != 5:
+    sys.stderr.write('usage: %s textures.json resources_dir out.c out.h\n' % sys.argv[0])
+    sys.exit(1)
+  main(*sys.argv[1:])
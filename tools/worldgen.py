@@ -0,0 +1,53 @@
+#!/usr/bin/env python
+#
+# Writes a streamed world resource (see src/world.c for the format).
+#
+#   worldgen.py out.bin [width_chunks height_chunks seed]
+#
+# The world is a grid of rooms, one per chunk: walls along the chunk's top
+# and left edges with a 2-square doorway in each, and a scattering of pillars
+# inside.  Same seed, same world, so resources/data/world.bin can be
+# regenerated and diffed.
+import random, struct, sys
+
+CHUNK = 16                                          # Squares per chunk side (CHUNK_SIZE)
+
+def build(width, height, seed):
+  rnd = random.Random(seed)
+  w, h = width * CHUNK, height * CHUNK
+  cells = [[0] * w for _ in range(h)]
+  for y in range(h):
+    for x in range(w):
+      ix, iy = x % CHUNK, y % CHUNK
+      if ix == 0 or iy == 0:                        # Room walls
+        door = (iy if ix == 0 else ix) in (CHUNK // 2 - 1, CHUNK // 2)
+        if not door or (ix == 0 and iy == 0): cells[y][x] = 1
+      elif ix > 1 and iy > 1 and rnd.random() < 0.06:  # Pillars, not blocking the doorways
+        cells[y][x] = (1, 1, 2, 3)[int(rnd.random() * 4)]
+  return cells
+
+def chunk_bytes(cells, cx, cy):
+  solid, attr = b'', bytearray(CHUNK * CHUNK // 2)
+  for y in range(CHUNK):
+    row = 0
+    for x in range(CHUNK):
+      value = cells[cy * CHUNK + y][cx * CHUNK + x]
+      if value > 0: row |= 1 << x
+      i = y * CHUNK + x
+      attr[i >> 1] |= (value & 7) << ((i & 1) * 4)
+    solid += struct.pack('<H', row)
+  return solid + bytes(attr)
+
+def main(out, width=16, height=16, seed=1):
+  width, height, seed = int(width), int(height), int(seed)
+  cells = build(width, height, seed)
+  with open(out, 'wb') as f:
+    f.write(struct.pack('<HH', width, height))
+    for cy in range(height):
+      for cx in range(width): f.write(chunk_bytes(cells, cx, cy))
+
+if __name__ == '__main__':
+  if len(sys.argv) not in (2, 5):
+    sys.stderr.write('usage: %s out.bin [width_chunks height_chunks seed]\n' % sys.argv[0])
+    sys.exit(1)
+  main(*sys.argv[1:])